@@ -1,88 +1,120 @@
 #include <string.h>
 
-#include <libopencm3/stm32/rcc.h>
-#include <libopencm3/stm32/gpio.h>
-#include <libopencm3/stm32/adc.h>
-#include <libopencm3/stm32/timer.h>
-#include <libopencm3/cm3/nvic.h>
-
-#include <core/usb_vcp.h>
-#include <core/millis.h>
-
+#include "hal.h"
 #include "chronograph.h"
+#include "settings.h"
 #include "display.h"
+#include "protocol.h"
+#include "command.h"
+#include "log.h"
+#include "stream.h"
+#include "snapshot.h"
+#include "format.h"
+#include "profile.h"
 #include "peak.h"
 
 // --------------------------------------------
 
-volatile enum {front_s, back_s, timeout_s} state;
+/* After a shot, post_s samples the rear gate for its snapshot
+ * window, before waiting for the next front trigger. */
+volatile enum {front_s, back_s, post_s, timeout_s} state;
+
+chrono_counters_t counters;
+
+cmd_queue_t cmd_queue;
 
 // --------------------------------------------
 
 void chrono();
-void chrono_stat_update(chrono_stat_t& stat, float measurement);
-float calc_fps(uint16_t ticks);
+void cmd_intake();
+void chrono_stat_reset(chrono_stat_t& stat);
+float calc_speed(uint16_t ticks);
+void report_shot(proto_shot_t &shot);
+void send_snapshot(const snapshot_t &snap);
+void cmd_output(const char *str);
+bool stream_stop();
+void cmd_apply(uint8_t actions, peak_stat_t &peak_stat,
+	uint16_t *samples, chrono_stat_t &chrono_stat);
 
 void test_sample_time();
+void test_sample_jitter(bool poll_vcp);
 void test_peak_samples();
 
-void adc_init();
-void adc_channel(uint8_t channel);
-uint32_t adc_read();
-void gpio_adc_init();
-
-void timer_init();
-uint16_t timer_read();
-void timer_start();
-void timer_stop();
-
 // --------------------------------------------
 
-extern "C" void tim2_isr(void) {
-	if(timer_get_flag(TIM2, TIM_SR_UIF)) {
-		timer_clear_flag(TIM2, TIM_SR_UIF);
-		
-		state = timeout_s;
-	}
+// TIM2 overflowed, before the rear trigger
+void chrono_timeout_isr() {
+	state = timeout_s;
 }
 
-int main() {
-	rcc_clock_setup_in_hse_8mhz_out_72mhz();
-	
-	millis_init();
-	vcp_init();
+// Command intake, see CMD_INTAKE_HZ
+void cmd_intake() {
+	/* When the queue is full, the rest stays
+	 * in the VCP, until the next intake. */
+	while(cmd_queue_space(cmd_queue) && vcp_available())
+		cmd_queue_push(cmd_queue, vcp_read());
+}
+
+// After hal_init()
+void chrono_main() {
+	settings_load();
 	
 	gpio_adc_init();
-	adc_init();
+	adc_init(settings.adc_sample_time, settings.adc_prescaler);
 	
 	timer_init();
 	display_init();
 	
+	// For the health counters, see chrono_counters_t
+	hal_cycles_init();
+	
+	PROF_INIT();
+	
 	// test_sample_time();
+	// test_sample_jitter(false);
+	// test_sample_jitter(true);
 	// test_peak_samples();
 	
 	chrono();
 }
 
 void chrono() {
-	uint16_t samples[PEAK_LAG];
+	uint16_t samples[PEAK_LAG_MAX];
 	peak_stat_t peak_stat;
 	chrono_stat_t chrono_stat;
 	
-	peak_stat_init(peak_stat, PEAK_THRESHOLD,
-		PEAK_INFLUENCE, PEAK_LAG, samples);
+	peak_stat_init(peak_stat, settings.peak_threshold,
+		settings.peak_influence, settings.peak_lag, samples);
+	
+	uint32_t last_trigger_ms = 0;
+	
+	// Health counters, see chrono_counters_t
+	uint32_t last_sample = 0;
+	uint16_t rear_max = 0;
+	
+	// Snapshot ring positions, see snapshot.h
+	uint32_t snap_pos = 0, snap_front = 0, snap_rear = 0;
+	bool snap_unsent = false;
+	
+	proto_shot_t shot = {.header = {.type = PROTO_SHOT}};
+	cmd_line_t cmd_line = {};
 	
-	chrono_stat = {.mode = mode_fps, .weight = 20};
-	display_draw_stat(chrono_stat);
+	chrono_stat_reset(chrono_stat);
+	display_request();
 	
 	adc_channel(CHANNEL_FRONT);
 	state = front_s;
 	
-	vcp_printf("Measuring!\n");
+	// Binary output is frames only
+	if(settings.output == output_text)
+		vcp_printf("Measuring!\n");
+	
+	cmd_intake_init();
 	
 	/* Discard the first ADC measurement,
 	 * which for some reason is way off.. */
 	adc_read();
+	last_sample = hal_cycles();
 	
 	while(1) {
 		uint16_t ticks, adc_val;
@@ -91,26 +123,116 @@ void chrono() {
 			adc_channel(CHANNEL_FRONT);
 			state = front_s;
 			
+			/* A rear pulse, even below the threshold, means the
+			 * rear gate missed the shot. Without one, the front
+			 * trigger was alone, e.g. noise, or off the gates' line. */
+			uint16_t average = peak_stat.elements ?
+				peak_stat.sample_sum / peak_stat.elements : rear_max;
+			
+			if(rear_max <= average + peak_stat.threshold / 2)
+				counters.front_only++;
+			
 			peak_stat_reset(peak_stat);
+			shot.timeouts++;
+			counters.timeouts++;
 			
-			DEBUG_PRINTF("TIMEOUT\n");
+			display_request();
+			
+			LOG(LOG_TIMEOUT, shot.timeouts);
 		}
 		
-		if(vcp_available()) {
-			if(vcp_read() == 'r') {
-				chrono_stat = {.mode = mode_fps, .weight = 20};
-				display_draw_stat(chrono_stat);
+		/* The rear window is complete, back to the front gate. The
+		 * detector saw the rear samples meanwhile, and starts over. */
+		if(state == post_s && snap_pos - snap_rear >= SNAP_POST) {
+			snap_capture(counters.shots, shot.ticks, snap_front, snap_rear, snap_pos);
+			snap_unsent = (settings.output == output_binary);
+			
+			adc_channel(CHANNEL_FRONT);
+			peak_stat_reset(peak_stat);
+			state = front_s;
+		}
+		
+		/* Redraw, and drain the log and snapshots, only while waiting for
+		 * a shot, and not right after a trigger, as a burst may be ongoing. */
+		if(state == front_s && (display_pending() || log_pending() || snap_unsent)) {
+			uint32_t now = millis();
+			
+			if(now - last_trigger_ms >= DISPLAY_IDLE_MS) {
+				if(display_pending()) {
+					uint32_t start = hal_cycles();
+					display_service(chrono_stat, now);
+					
+					uint32_t cycles = hal_cycles() - start;
+					counters.display_us += CYCLES_TO_US(cycles);
+					
+					if(cycles > counters.display_max)
+						counters.display_max = cycles;
+				}
+				
+				if(log_pending())
+					log_service(settings.log);
+				
+				if(snap_unsent) {
+					send_snapshot(*snap_get(0));
+					snap_unsent = false;
+				}
 			}
 		}
 		
+		/* The VCP is polled here rather than from an interrupt, which
+		 * would preempt the sampling, also while waiting for the front
+		 * trigger. Only in the idle window, as the redraws. Per sample,
+		 * this costs reading TIM3's flag. */
+		if(state == front_s && cmd_intake_due()
+				&& millis() - last_trigger_ms >= DISPLAY_IDLE_MS)
+			cmd_intake();
+		
+		/* Commands are only handled between shots, so that
+		 * changes never apply to a shot in flight. */
+		if(state == front_s && cmd_queue_has_line(cmd_queue)) {
+			do {
+				uint8_t actions = cmd_input(cmd_line,
+					cmd_queue_pop(cmd_queue), cmd_output);
+				
+				if(actions) {
+					cmd_apply(actions, peak_stat, samples, chrono_stat);
+					
+					// Streaming, or a flash write, isn't a loop stall
+					last_sample = hal_cycles();
+				}
+			} while(cmd_queue_has_line(cmd_queue));
+		}
+		
+		// From the previous sample, including all the above
+		uint32_t sample_cycles = hal_cycles();
+		
+		if(sample_cycles - last_sample > counters.max_gap)
+			counters.max_gap = sample_cycles - last_sample;
+		
+		last_sample = sample_cycles;
+		
 		ticks = timer_read();
+		PROF_START(PROF_ADC);
 		adc_val = adc_read();
+		PROF_STOP(PROF_ADC);
 		
-		if(!peak_detect(peak_stat, adc_val))
+		snap_sample(snap_pos, adc_val);
+		
+		PROF_START(PROF_PEAK);
+		bool has_peak = peak_detect(peak_stat, adc_val);
+		PROF_STOP(PROF_PEAK);
+		
+		if(!has_peak) {
+			if(state == back_s && adc_val > rear_max)
+				rear_max = adc_val;
+			
 			continue;
+		}
 		
 		/* Peak detected */
 		
+		uint16_t peak = peak_stat.peak;
+		
 		peak_stat_reset(peak_stat);
 		
 		if(state == front_s) {
@@ -119,43 +241,180 @@ void chrono() {
 			adc_channel(CHANNEL_REAR);
 			state = back_s;
 			
-			DEBUG_PRINTF("FD\n");
+			last_trigger_ms = millis();
+			rear_max = 0;
+			shot.front_peak = peak;
+			snap_front = snap_pos - 1;
+			
+			LOG(LOG_FRONT, peak);
 		} else if(state == back_s) {
 			timer_stop();
 			
-			float fps = calc_fps(ticks);
+			shot.ticks = ticks;
+			shot.rear_peak = peak;
+			
+			PROF_START(PROF_CALC);
+			shot.speed = calc_speed(ticks);
+			
+			// Still reported, and in the stats
+			if(shot.speed == 0 || shot.speed > SUSPECT_SPEED_MPS) {
+				counters.suspect++;
+				LOG(LOG_SUSPECT, ticks);
+			}
+			
+			// Captured in post_s, SNAP_POST samples later
+			snap_rear = snap_pos - 1;
+			
+			float fps = shot.speed * MPS_TO_FPS_FACTOR;
 			
 			chrono_stat_update(chrono_stat, fps);
-			display_draw_stat(chrono_stat);
+			PROF_STOP(PROF_CALC);
 			
-			adc_channel(CHANNEL_FRONT);
-			state = front_s;
+			display_request();
+			
+			counters.shots++;
+			
+			PROF_START(PROF_REPORT);
+			report_shot(shot);
+			PROF_STOP(PROF_REPORT);
+			
+			shot.timeouts = 0;
+			
+			// Still on the rear gate, for the snapshot
+			state = post_s;
 		}
 	}
 }
 
-void chrono_stat_update(chrono_stat_t& stat, float measurement) {
-	stat.measurement = measurement;
-	stat.count++;
-	
-	stat.m_sum += measurement;
-	stat.m_sqsum += measurement*measurement;
+void chrono_stat_reset(chrono_stat_t& stat) {
+	stat = {
+		.mode = (chrono_mode_t) settings.mode,
+		.weight = settings.weight
+	};
 }
 
-float calc_fps(uint16_t ticks) {
+// Calibrated speed (m/s)
+float calc_speed(uint16_t ticks) {
 	if(ticks == 0) {
-		DEBUG_PRINTF("ticks: 0\n");
+		LOG(LOG_ZERO_TICKS);
 		return 0;
 	}
 	
 	float dt_us = TICKS_TO_US(ticks);
-	float speed = DISTANCE_UM / dt_us * SPEED_CALIBRATION_FACTOR;
-	float fps = speed * MPS_TO_FPS_FACTOR;
 	
-	vcp_printf("ticks: %u dt(us): %u U(m/s): %u U(fps): %u\n",
-		ticks, (int) dt_us, (int) speed, (int) fps);
+	return settings.distance_um / dt_us * settings.calibration;
+}
+
+void report_shot(proto_shot_t &shot) {
+	if(settings.output == output_binary) {
+		shot.time_ms = millis();
+		shot.timer_freq = TIMER_FREQ;
+		shot.distance_um = settings.distance_um;
+		
+		proto_send(shot.header, sizeof(shot));
+		return;
+	}
+	
+	float fps = shot.speed * MPS_TO_FPS_FACTOR;
+	char line[80], *p;
+	
+	// "ticks: %u dt(us): %u U(m/s): %u U(fps): %u\n"
+	PROF_START(PROF_FORMAT);
+	p = fmt_uint(fmt_str(line, "ticks: "), shot.ticks);
+	p = fmt_uint(fmt_str(p, " dt(us): "), (int) TICKS_TO_US(shot.ticks));
+	p = fmt_uint(fmt_str(p, " U(m/s): "), (int) shot.speed);
+	p = fmt_uint(fmt_str(p, " U(fps): "), (int) fps);
+	fmt_str(p, "\n");
+	PROF_STOP(PROF_FORMAT);
+	
+	vcp_printf("%s", line);
+}
+
+void send_snapshot(const snapshot_t &snap) {
+	proto_snap_t record = {
+		.header = {.type = PROTO_SNAP},
+		.shot = snap.shot,
+		.ticks = snap.ticks,
+		.pre = SNAP_PRE
+	};
 	
-	return fps;
+	for(uint8_t t = SNAP_FRONT; t <= SNAP_REAR; t++) {
+		if(!snap.valid[t])
+			continue;
+		
+		record.trigger = t;
+		memcpy(record.samples, snap.samples[t], sizeof(record.samples));
+		
+		proto_send(record.header, sizeof(record));
+	}
+}
+
+void cmd_output(const char *str) {
+	vcp_printf("%s", str);
+}
+
+/* Streaming ends with the next command line, which is discarded.
+ * The main loop's intake doesn't run while streaming, so this one
+ * polls it. */
+bool stream_stop() {
+	if(cmd_intake_due())
+		cmd_intake();
+	
+	if(!cmd_queue_has_line(cmd_queue))
+		return false;
+	
+	while(cmd_queue_has_line(cmd_queue))
+		cmd_queue_pop(cmd_queue);
+	
+	return true;
+}
+
+// Apply the changes of a command, see command.h
+void cmd_apply(uint8_t actions, peak_stat_t &peak_stat,
+		uint16_t *samples, chrono_stat_t &chrono_stat) {
+	
+	LOG(LOG_CMD_APPLY, actions);
+	
+	if(actions & CMD_STREAM) {
+		stream_run(stream_stop);
+		
+		// Back to single conversions
+		actions |= CMD_APPLY_ADC;
+	}
+	
+	if(actions & CMD_APPLY_PEAK) {
+		peak_stat_init(peak_stat, settings.peak_threshold,
+			settings.peak_influence, settings.peak_lag, samples);
+	}
+	
+	if(actions & CMD_APPLY_ADC) {
+		adc_init(settings.adc_sample_time, settings.adc_prescaler);
+		adc_channel(CHANNEL_FRONT);
+		
+		// As in chrono(), the first measurement is off
+		adc_read();
+		
+		peak_stat_reset(peak_stat);
+	}
+	
+	if(actions & CMD_APPLY_STAT) {
+		chrono_stat.mode = (chrono_mode_t) settings.mode;
+		chrono_stat.weight = settings.weight;
+		display_request();
+	}
+	
+	if(actions & CMD_RESET) {
+		chrono_stat_reset(chrono_stat);
+		display_request();
+	}
+	
+	if(actions & CMD_PAGE) {
+		display_next_page();
+		display_request();
+	}
+	
+	if(actions & CMD_SAVE)
+		vcp_printf(settings_save() ? "OK\n" : "ERR save failed\n");
 }
 
 // --------------------------------------------
@@ -179,12 +438,67 @@ void test_sample_time() {
 		(t2 - t)/1000, (t2 - t) % 1000 / 100);
 }
 
+/* Sample period jitter, measured with the cycle counter, over
+ * 10 windows of 100000 samples. With poll_vcp, the VCP is polled
+ * in the sample loop, as the command intake used to. Otherwise,
+ * it's drained at CMD_INTAKE_HZ, as in chrono(). Run it with and without
+ * traffic on the VCP, e.g. `yes get > /dev/ttyACM0`.
+ *
+ * Reported per window: min/avg/max sample period (ns), and the
+ * number of periods more than 500 ns above the minimum. */
+void test_sample_jitter(bool poll_vcp) {
+	uint16_t samples[16];
+	peak_stat_t peak_stat;
+	
+	peak_stat_init(peak_stat, 5000, 0, 16, samples);
+	hal_cycles_init();
+	
+	// Cycles, at 72 MHz
+	const uint32_t slow = 36;
+	
+	if(!poll_vcp)
+		cmd_intake_init();
+	
+	vcp_printf("Sample jitter, %s\n", poll_vcp ? "polled" : "intake timer");
+	
+	for(int w = 0; w < 10; w++) {
+		uint32_t min = UINT32_MAX, max = 0, num_slow = 0;
+		uint32_t start = hal_cycles(), prev = start;
+		
+		for(int i = 0; i < 100000; i++) {
+			if(poll_vcp && vcp_available())
+				vcp_read();
+			else if(!poll_vcp && cmd_intake_due())
+				cmd_intake();
+			
+			peak_detect(peak_stat, adc_read());
+			
+			uint32_t now = hal_cycles();
+			uint32_t period = now - prev;
+			prev = now;
+			
+			if(period < min) min = period;
+			if(period > max) max = period;
+			if(period > min + slow) num_slow++;
+		}
+		
+		uint32_t avg = (prev - start) / 100000;
+		
+		vcp_printf("min %u avg %u max %u ns, slow %u\n",
+			min * 1000 / 72, avg * 1000 / 72, max * 1000 / 72, num_slow);
+		
+		// Discard what was queued
+		while(!poll_vcp && cmd_queue.tail != cmd_queue.head)
+			cmd_queue_pop(cmd_queue);
+	}
+}
+
 void test_peak_samples() {
-	uint16_t samples[PEAK_LAG];
+	uint16_t samples[PEAK_LAG_MAX];
 	peak_stat_t peak_stat;
 	
-	peak_stat_init(peak_stat, PEAK_THRESHOLD,
-		0, PEAK_LAG, samples);
+	peak_stat_init(peak_stat, settings.peak_threshold,
+		0, settings.peak_lag, samples);
 	
 	adc_channel(CHANNEL_FRONT);
 	// adc_channel(CHANNEL_REAR);
@@ -194,135 +508,13 @@ void test_peak_samples() {
 		
 		if(peak_detect(peak_stat, adc_val)) {
 			int samples = 1;
-			int avg = peak_stat.sample_sum/peak_stat.elements;
+			int first = peak_stat.peak;
 			
 			while(peak_detect(peak_stat, adc_read()))
 				samples++;
 			
 			vcp_printf("Peak detected. First (diff): %d. "
-				"Total samples: %d\n", adc_val - avg, samples);
+				"Total samples: %d\n", first, samples);
 		}
 	}
 }
-
-// --------------------------------------------
-
-void adc_init() {
-	rcc_periph_clock_enable(RCC_ADC1);
-	rcc_set_adcpre(RCC_CFGR_ADCPRE_PCLK2_DIV2);
-	
-	adc_power_off(ADC1);
-	rcc_periph_reset_pulse(RST_ADC1);
-	
-	/* These measurements include the time for the peak detection
-	 * algorithm to work, and are obtained with an ADC prescaler
-	 * value of 2 (RCC_CFGR_ADCPRE_PCLK2_DIV2) unless otherwise
-	 * specified, and varying sample times.
-	 *
-	 * Initially, the smallest possible sampling time, 1DOT5CYC, was
-	 * used. It gave 1.7 us sampling time, but the measurements were
-	 * pretty unstable. (perhaps also because of external factors
-	 * belonging in the magestic realm of analog electronics)
-	 *
-	 * We can actually go higher with our sampling times. The main
-	 * limiting factor is the maximum projectile speed we wish to
-	 * measure, coupled with the sensing distance of our diodes.
-	 * Is some cases, if the peak detection algorithm, has an
-	 * "on-the-fly" training period the diode distance could also
-	 * affect the sampling time.
-	 *
-	 * With ADC_SMPR_SMP_28DOT5CYC, we get 2.4us/sample, and the
-	 * measurement are already much more stable. But, we can go
-	 * even higher.
-	 *
-	 * While this is unconfirmed/untested, we would wish to have
-	 * higher sampling cycles because we appear to get more stable
-	 * values this way. More stable values allow us to have higher
-	 * tolerances in our peak detection, which in turn can help
-	 * translate into higher sensitivity (so more user friendliness),
-	 * along with higher accuracy.
-	 *
-	 * With my specific 3D-printed chrono case, I measured the detection
-	 * area to be between 3~5 mm. Assuming a maximum measurement speed
-	 * of ~250 m/s (820 fps), supposing the worst case of 3 mm, a speed
-	 * of 250 m/s, and a mininum required amount of 2 samples, we arrive
-	 * at a sampling time of 5-6 us.
-	 *
-	 * ADC_SMPR_SMP_71DOT5CYC gives a sample time of 3.6 us.
-	 * ADC_SMPR_SMP_239DOT5CYC gives a sample time of 8.4 us.
-	 *
-	 * ADC_SMPR_SMP_71DOT5CYC and RCC_CFGR_ADCPRE_PCLK2_DIV4
-	 * give a sample time of 6 us.
-	 *
-	 * However, there also other concerns when choosing high sample times:
-	 * 1. If the trigger is off by even one sample, a higher speed fault
-	 *   will be introduced compared to a smaller sample time.
-	 * 2. Does it even make sense trying to read a stable measurement,
-	 *   if the environment is volatile whilst sampling it?
-	 *
-	 * Regarding point (1), at 100 m/s, 1 sample's fault is worth:
-	 *   At 2.4us/sample, 0.8 m/s or 2.6 fps
-	 *   At 6us/sample, 2 m/s or 6.5 fps
-	 *   At 8us/sample, 2.6 m/s or 8.5 fps
-	 */
-	
-	adc_set_sample_time_on_all_channels(ADC1, ADC_SMPR_SMP_28DOT5CYC);
-	adc_enable_external_trigger_regular(ADC1, ADC_CR2_EXTSEL_SWSTART);
-
-	adc_power_on(ADC1);
-
-	for(int i = 0; i < 50; i++)
-		__asm__("nop");
-
-	adc_reset_calibration(ADC1);
-	adc_calibrate(ADC1);
-}
-
-void adc_channel(uint8_t channel) {
-    adc_set_regular_sequence(ADC1, 1, &channel);
-}
-
-uint32_t adc_read() {
-	adc_start_conversion_regular(ADC1);
-	while(!adc_eoc(ADC1));
-	
-	return adc_read_regular(ADC1);
-}
-
-void gpio_adc_init() {
-    rcc_periph_clock_enable(RCC_GPIOA);
-    gpio_set_mode(GPIOA, GPIO_MODE_INPUT, GPIO_CNF_INPUT_ANALOG, GPIO0);
-    gpio_set_mode(GPIOA, GPIO_MODE_INPUT, GPIO_CNF_INPUT_ANALOG, GPIO1);
-}
-
-void timer_init() {
-	rcc_periph_clock_enable(RCC_TIM2);
-	rcc_periph_reset_pulse(RST_TIM2);
-	
-	timer_set_prescaler(TIM2, (rcc_apb1_frequency * 2) / TIMER_FREQ);
-	timer_set_period(TIM2, TIMER_ARR);
-	timer_one_shot_mode(TIM2);
-	
-	/* For some reason, the first time the counter is enabled,
-	 * a UEV is generated immediately. So, we handle this here. */
-	timer_set_counter(TIM2, TIMER_ARR);
-	timer_enable_counter(TIM2);
-	while(!timer_get_flag(TIM2, TIM_SR_UIF));
-	timer_clear_flag(TIM2, TIM_SR_UIF);
-	
-	nvic_enable_irq(NVIC_TIM2_IRQ);
-	timer_enable_irq(TIM2, TIM_DIER_UIE);
-}
-
-uint16_t timer_read() {
-	return timer_get_counter(TIM2);
-}
-
-void timer_start() {
-	timer_set_counter(TIM2, 0);
-	timer_enable_counter(TIM2);
-}
-
-void timer_stop() {
-	timer_disable_counter(TIM2);
-}
@@ -4,40 +4,61 @@
 #include <libopencm3/stm32/adc.h>
 #include <core/types.h>
 
-// -------------------------------------------------
+#include "histogram.h"
+#include "trend.h"
 
-// Verbose Output
-// #define DEBUG
-#ifdef DEBUG
-	#define DEBUG_PRINTF(...) vcp_printf(__VA_ARGS__)
-#else
-	#define DEBUG_PRINTF(...) ;
-#endif
+// -------------------------------------------------
 
 // Photodiode ADC channels
 #define CHANNEL_FRONT ADC_CHANNEL0
 #define CHANNEL_REAR ADC_CHANNEL1
 
+/* The following are the defaults of the runtime settings,
+ * used when no valid settings are stored in flash. */
+
 // Peak Detection
 #define PEAK_LAG 50
 #define PEAK_THRESHOLD 80
 #define PEAK_INFLUENCE 1
 
+// Size of the peak detection sample buffer
+#define PEAK_LAG_MAX 128
+
+// ADC sample time and PCLK2 prescaler, see adc_init()
+#define ADC_SAMPLE_TIME ADC_SMPR_SMP_28DOT5CYC
+#define ADC_PRESCALER 2
+
 // Max ticks measured = TIMER_ARR
 // Max time measured = TIMER_ARR/TIMER_FREQ
 // One tick equals 1/TIMER_FREQ seconds
 #define TIMER_ARR 0xFFFF
 #define TIMER_FREQ ((int) 30e06)
 
+/* Received VCP data is moved to the command queue by the main loop,
+ * at this rate, while waiting for a shot, and by stream_stop() while
+ * streaming. TIM3 paces it, without its interrupt, so that nothing
+ * preempts the sampling. */
+#define CMD_INTAKE_HZ 1000
+
 // Convert timer ticks to micro seconds
 #define TICKS_TO_US(ticks) ((float) (ticks) * 1e06 / TIMER_FREQ)
 
+// Convert hal_cycles() differences to micro seconds
+#define CYCLES_TO_US(cycles) ((cycles) / 72)
+
+/* Shots faster than this are counted as suspect, e.g. a flash seen
+ * by both gates, not a projectile. They are still reported (m/s). */
+#define SUSPECT_SPEED_MPS 1000
+
 // Distance of diodes (10^-6 m)
 #define DISTANCE_UM 30000
 
 // Fine-grain calibration
 #define SPEED_CALIBRATION_FACTOR 1
 
+// Projectile weight (10^-2 g)
+#define WEIGHT 20
+
 // Used to convert m/s to fps
 #define MPS_TO_FPS_FACTOR ((float) 3.2808398950131);
 
@@ -50,6 +71,19 @@ typedef enum {
 	mode_rps
 } chrono_mode_t;
 
+// Shot reports over the VCP: text lines, or protocol.h frames
+typedef enum {
+	output_text,
+	output_binary
+} chrono_output_t;
+
+// The log's output, see log.h. Off by default.
+typedef enum {
+	log_off,
+	log_binary,
+	log_text
+} chrono_log_t;
+
 typedef struct {
 	chrono_mode_t mode;
 	int weight;
@@ -59,8 +93,48 @@ typedef struct {
 	
 	float m_sum;
 	float m_sqsum;
+	
+	hist_t hist;
+	trend_t trend;
 } chrono_stat_t;
 
+/* Since boot, see the "counters" command and the diagnostics page.
+ * Updated in the main loop, at a few cycles per sample. */
+typedef struct {
+	uint32_t shots;
+	
+	// Front triggers without a rear one, and those of them
+	// where the rear gate didn't even see a pulse
+	uint32_t timeouts;
+	uint32_t front_only;
+	
+	// Shots with zero ticks, or above SUSPECT_SPEED_MPS
+	uint32_t suspect;
+	
+	// Longest sample period (cycles)
+	uint32_t max_gap;
+	
+	// Spent redrawing the display, in total (us), and at most (cycles)
+	uint32_t display_us;
+	uint32_t display_max;
+} chrono_counters_t;
+
+extern chrono_counters_t counters;
+
+// After hal_init(), see hal_stm32.cpp and host/chrono_sim.cpp
+void chrono_main();
+
+inline void chrono_stat_update(chrono_stat_t& stat, float measurement) {
+	stat.measurement = measurement;
+	stat.count++;
+	
+	stat.m_sum += measurement;
+	stat.m_sqsum += measurement*measurement;
+	
+	hist_add(stat.hist, measurement);
+	trend_add(stat.trend, measurement);
+}
+
 // -------------------------------------------------
 
 #endif
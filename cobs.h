@@ -0,0 +1,70 @@
+#ifndef COBS_H
+#define COBS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Consistent Overhead Byte Stuffing. The encoded data contains
+ * no zero bytes, so a zero can delimit frames, and a receiver
+ * can resynchronize at the next one after any corruption.
+ *
+ * Encoding adds one byte, plus one for every 254 bytes. */
+
+#define COBS_MAX_ENCODED(len) ((len) + (len) / 254 + 1)
+
+inline size_t cobs_encode(const uint8_t *src, size_t len, uint8_t *dst) {
+	size_t code_pos = 0, out = 1;
+	uint8_t code = 1;
+	
+	for(size_t i = 0; i < len; i++) {
+		if(src[i] == 0) {
+			dst[code_pos] = code;
+			code_pos = out++;
+			code = 1;
+			continue;
+		}
+		
+		dst[out++] = src[i];
+		
+		if(++code == 0xFF) {
+			dst[code_pos] = code;
+			code_pos = out++;
+			code = 1;
+		}
+	}
+	
+	dst[code_pos] = code;
+	
+	return out;
+}
+
+/* Decodes into dst, of dst_cap bytes. Returns the decoded length,
+ * or -1 if the data isn't valid COBS, or doesn't fit. */
+inline int cobs_decode(const uint8_t *src, size_t len, uint8_t *dst, size_t dst_cap) {
+	size_t in = 0, out = 0;
+	
+	while(in < len) {
+		uint8_t code = src[in++];
+		
+		if(code == 0 || in + code - 1 > len)
+			return -1;
+		
+		for(uint8_t i = 1; i < code; i++) {
+			if(src[in] == 0 || out == dst_cap)
+				return -1;
+			
+			dst[out++] = src[in++];
+		}
+		
+		if(code != 0xFF && in < len) {
+			if(out == dst_cap)
+				return -1;
+			
+			dst[out++] = 0;
+		}
+	}
+	
+	return out;
+}
+
+#endif
@@ -0,0 +1,446 @@
+#include <string.h>
+#include <stddef.h>
+
+#include "command.h"
+#include "chronograph.h"
+#include "settings.h"
+#include "format.h"
+#include "snapshot.h"
+#include "profile.h"
+
+// --------------------------------------------
+
+typedef enum {
+	param_u8,
+	param_u16,
+	param_u32,
+	param_float,
+	param_enum
+} param_type_t;
+
+typedef struct {
+	const char *name;
+	uint8_t type;
+	uint8_t offset;
+	
+	// CMD_* actions, when changed
+	uint8_t apply;
+	
+	// param_enum value names, indexed by value
+	const char *const *names;
+	uint8_t num_names;
+} param_t;
+
+static const char *const mode_names[] = {"fps", "mps", "joule", "rps"};
+static const char *const output_names[] = {"text", "binary"};
+static const char *const log_names[] = {"off", "binary", "text"};
+
+// ADC_SMPR_SMP_* sample times, in ADC cycles
+static const char *const sample_time_names[] = {
+	"1.5", "7.5", "13.5", "28.5", "41.5", "55.5", "71.5", "239.5"
+};
+
+#define PARAM(name, type, field, apply) \
+	{name, type, offsetof(chrono_settings_t, field), apply, NULL, 0}
+#define PARAM_ENUM(name, field, apply, names) \
+	{name, param_enum, offsetof(chrono_settings_t, field), apply, \
+		names, sizeof(names) / sizeof(*names)}
+
+static const param_t params[] = {
+	PARAM("threshold", param_u16, peak_threshold, CMD_APPLY_PEAK),
+	PARAM("lag", param_u16, peak_lag, CMD_APPLY_PEAK),
+	PARAM("influence", param_u16, peak_influence, CMD_APPLY_PEAK),
+	PARAM_ENUM("sample_time", adc_sample_time, CMD_APPLY_ADC, sample_time_names),
+	PARAM("prescaler", param_u8, adc_prescaler, CMD_APPLY_ADC),
+	PARAM("distance", param_u32, distance_um, 0),
+	PARAM("calibration", param_float, calibration, 0),
+	PARAM_ENUM("mode", mode, CMD_APPLY_STAT, mode_names),
+	PARAM("weight", param_u16, weight, CMD_APPLY_STAT),
+	PARAM_ENUM("output", output, 0, output_names),
+	PARAM_ENUM("log", log, 0, log_names),
+};
+
+#define NUM_PARAMS (sizeof(params) / sizeof(*params))
+
+// --------------------------------------------
+
+static bool parse_uint(const char *str, uint32_t *value) {
+	uint32_t v = 0;
+	
+	if(!*str)
+		return false;
+	
+	for(; *str; str++) {
+		if(*str < '0' || *str > '9' || v > (UINT32_MAX - 9) / 10)
+			return false;
+		
+		v = v * 10 + (*str - '0');
+	}
+	
+	*value = v;
+	return true;
+}
+
+// Unsigned, with up to 6 decimals
+static bool parse_float(const char *str, float *value) {
+	uint32_t integer = 0, fraction = 0, scale = 1;
+	bool digits = false;
+	
+	for(; *str >= '0' && *str <= '9'; str++, digits = true) {
+		if(integer > (UINT32_MAX - 9) / 10)
+			return false;
+		
+		integer = integer * 10 + (*str - '0');
+	}
+	
+	if(*str == '.') {
+		for(str++; *str >= '0' && *str <= '9'; str++, digits = true) {
+			if(scale == 1000000)
+				return false;
+			
+			fraction = fraction * 10 + (*str - '0');
+			scale *= 10;
+		}
+	}
+	
+	if(*str || !digits)
+		return false;
+	
+	*value = integer + (float) fraction / scale;
+	return true;
+}
+
+static const param_t *find_param(const char *name) {
+	for(size_t i = 0; i < NUM_PARAMS; i++) {
+		if(strcmp(params[i].name, name) == 0)
+			return &params[i];
+	}
+	
+	return NULL;
+}
+
+static char *param_format(char *dst, const param_t &p, const chrono_settings_t &s) {
+	const uint8_t *field = (const uint8_t *) &s + p.offset;
+	uint32_t v = 0;
+	
+	switch(p.type) {
+		case param_u8: case param_enum: v = *field; break;
+		case param_u16: v = *(const uint16_t *) field; break;
+		case param_u32: v = *(const uint32_t *) field; break;
+		
+		case param_float:
+			return fmt_fixed(dst, *(const float *) field, 4);
+	}
+	
+	if(p.type == param_enum && v < p.num_names)
+		return fmt_str(dst, p.names[v]);
+	
+	return fmt_uint(dst, v);
+}
+
+static bool param_parse(const param_t &p, chrono_settings_t &s, const char *str) {
+	uint8_t *field = (uint8_t *) &s + p.offset;
+	uint32_t v;
+	
+	switch(p.type) {
+		case param_float:
+			return parse_float(str, (float *) field);
+		
+		case param_enum:
+			for(uint8_t i = 0; i < p.num_names; i++) {
+				if(strcmp(p.names[i], str) == 0) {
+					*field = i;
+					return true;
+				}
+			}
+			
+			return false;
+	}
+	
+	if(!parse_uint(str, &v))
+		return false;
+	
+	switch(p.type) {
+		case param_u8:
+			if(v > UINT8_MAX) return false;
+			*field = v;
+			break;
+		
+		case param_u16:
+			if(v > UINT16_MAX) return false;
+			*(uint16_t *) field = v;
+			break;
+		
+		case param_u32:
+			*(uint32_t *) field = v;
+			break;
+	}
+	
+	return true;
+}
+
+// --------------------------------------------
+
+static void print_param(const param_t &p, cmd_output_t out) {
+	char buffer[CMD_LINE_MAX];
+	
+	char *end = param_format(fmt_str(fmt_str(buffer, p.name), "="), p, settings);
+	fmt_str(end, "\n");
+	
+	out(buffer);
+}
+
+static uint8_t cmd_get(const char *name, cmd_output_t out) {
+	if(!name) {
+		for(size_t i = 0; i < NUM_PARAMS; i++)
+			print_param(params[i], out);
+		
+		return 0;
+	}
+	
+	const param_t *p = find_param(name);
+	
+	if(!p) {
+		out("ERR unknown parameter\n");
+		return 0;
+	}
+	
+	print_param(*p, out);
+	return 0;
+}
+
+/* Changes are made on a copy, and only kept if the resulting
+ * settings pass settings_validate(), so `settings` is always valid. */
+static uint8_t cmd_set(const char *name, const char *value, cmd_output_t out) {
+	const param_t *p = (name ? find_param(name) : NULL);
+	chrono_settings_t s = settings;
+	
+	if(!p) {
+		out("ERR unknown parameter\n");
+		return 0;
+	}
+	
+	if(!value || !param_parse(*p, s, value)) {
+		out("ERR bad value\n");
+		return 0;
+	}
+	
+	if(!settings_validate(s)) {
+		out("ERR out of range\n");
+		return 0;
+	}
+	
+	settings = s;
+	print_param(*p, out);
+	
+	return p->apply;
+}
+
+static uint8_t cmd_counters(const char *arg, cmd_output_t out) {
+	char buffer[CMD_LINE_MAX];
+	
+	// The shots number the snapshots, and stay
+	if(arg && strcmp(arg, "reset") == 0) {
+		counters = (chrono_counters_t) {.shots = counters.shots};
+		out("OK\n");
+		return 0;
+	}
+	
+	if(arg) {
+		out("ERR bad value\n");
+		return 0;
+	}
+	
+	const struct {
+		const char *name;
+		uint32_t value;
+	} lines[] = {
+		{"shots=", counters.shots},
+		{"timeouts=", counters.timeouts},
+		{"front_only=", counters.front_only},
+		{"suspect=", counters.suspect},
+		{"max_gap_us=", CYCLES_TO_US(counters.max_gap)},
+		{"display_ms=", counters.display_us / 1000},
+		{"display_max_us=", CYCLES_TO_US(counters.display_max)}
+	};
+	
+	for(size_t i = 0; i < sizeof(lines) / sizeof(lines[0]); i++) {
+		fmt_str(fmt_uint(fmt_str(buffer, lines[i].name), lines[i].value), "\n");
+		out(buffer);
+	}
+	
+	return 0;
+}
+
+static uint8_t cmd_snap(const char *index, cmd_output_t out) {
+	char buffer[CMD_LINE_MAX];
+	uint32_t k = 0;
+	
+	if(index && (!parse_uint(index, &k) || k > UINT8_MAX)) {
+		out("ERR bad value\n");
+		return 0;
+	}
+	
+	const snapshot_t *snap = snap_get(k);
+	
+	if(!snap) {
+		out("ERR no snapshot\n");
+		return 0;
+	}
+	
+	char *end = fmt_uint(fmt_str(buffer, "shot="), snap->shot);
+	end = fmt_uint(fmt_str(end, " ticks="), snap->ticks);
+	fmt_str(fmt_uint(fmt_str(end, " pre="), SNAP_PRE), "\n");
+	out(buffer);
+	
+	for(int t = SNAP_FRONT; t <= SNAP_REAR; t++) {
+		out(t == SNAP_FRONT ? "front:" : "rear:");
+		
+		if(!snap->valid[t]) {
+			out(" overwritten\n");
+			continue;
+		}
+		
+		out("\n");
+		
+		// 8 per line
+		for(int i = 0; i < SNAP_WINDOW; i += 8) {
+			end = buffer;
+			
+			for(int j = i; j < i + 8; j++)
+				end = fmt_uint(end, snap->samples[t][j], 5);
+			
+			fmt_str(end, "\n");
+			out(buffer);
+		}
+	}
+	
+	return 0;
+}
+
+static uint8_t cmd_prof(const char *arg, cmd_output_t out) {
+#if defined(PROFILE)
+	if(!arg) {
+		prof_print(out);
+		return 0;
+	}
+	
+	if(strcmp(arg, "reset") == 0) {
+		prof_reset();
+		out("OK\n");
+		return 0;
+	}
+	
+	out("ERR bad value\n");
+#else
+	(void) arg;
+	out("ERR not profiled\n");
+#endif
+	
+	return 0;
+}
+
+static uint8_t cmd_help(cmd_output_t out) {
+	out("get [name] | set <name> <value> | save | defaults | "
+		"counters [reset] | reset | page | stream | snap [k] | prof [reset]\n");
+	
+	for(size_t i = 0; i < NUM_PARAMS; i++) {
+		out(params[i].name);
+		out(i + 1 < NUM_PARAMS ? " " : "\n");
+	}
+	
+	return 0;
+}
+
+uint8_t cmd_exec(char *line, cmd_output_t out) {
+	char *argv[3] = {};
+	int argc = 0;
+	
+	// Split into space-separated words, at most 3
+	for(char *p = line; *p; ) {
+		while(*p == ' ' || *p == '\t' || *p == '\r')
+			*p++ = '\0';
+		
+		if(!*p)
+			break;
+		
+		if(argc == 3) {
+			out("ERR too many arguments\n");
+			return 0;
+		}
+		
+		argv[argc++] = p;
+		
+		while(*p && *p != ' ' && *p != '\t' && *p != '\r')
+			p++;
+	}
+	
+	if(argc == 0)
+		return 0;
+	
+	const char *cmd = argv[0];
+	
+	if(strcmp(cmd, "get") == 0)
+		return cmd_get(argv[1], out);
+	if(strcmp(cmd, "set") == 0)
+		return cmd_set(argv[1], argv[2], out);
+	if(strcmp(cmd, "counters") == 0)
+		return cmd_counters(argv[1], out);
+	if(strcmp(cmd, "snap") == 0)
+		return cmd_snap(argv[1], out);
+	if(strcmp(cmd, "prof") == 0)
+		return cmd_prof(argv[1], out);
+	if(strcmp(cmd, "help") == 0)
+		return cmd_help(out);
+	
+	if(strcmp(cmd, "save") == 0)
+		return CMD_SAVE;
+	if(strcmp(cmd, "stream") == 0)
+		return CMD_STREAM;
+	
+	if(strcmp(cmd, "defaults") == 0) {
+		settings_defaults(settings);
+		out("OK\n");
+		
+		return CMD_APPLY_PEAK | CMD_APPLY_ADC | CMD_APPLY_STAT;
+	}
+	
+	if(strcmp(cmd, "reset") == 0 || strcmp(cmd, "r") == 0) {
+		out("OK\n");
+		return CMD_RESET;
+	}
+	
+	if(strcmp(cmd, "page") == 0 || strcmp(cmd, "p") == 0) {
+		out("OK\n");
+		return CMD_PAGE;
+	}
+	
+	out("ERR unknown command\n");
+	return 0;
+}
+
+uint8_t cmd_input(cmd_line_t &line, char c, cmd_output_t out) {
+	// Terminals send CR, pipes LF, empty lines are ignored
+	if(!cmd_is_eol(c)) {
+		if(line.len < CMD_LINE_MAX - 1)
+			line.buf[line.len++] = c;
+		else
+			line.overflow = true;
+		
+		return 0;
+	}
+	
+	uint8_t actions = 0;
+	
+	if(line.overflow) {
+		out("ERR line too long\n");
+	} else {
+		line.buf[line.len] = '\0';
+		actions = cmd_exec(line.buf, out);
+	}
+	
+	line.len = 0;
+	line.overflow = false;
+	
+	return actions;
+}
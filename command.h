@@ -0,0 +1,117 @@
+/**
+ * Line-based command interface, over the VCP.
+ *
+ * get [name]           print one or all parameters
+ * set <name> <value>   validate and change a parameter
+ * save                 store the parameters in flash
+ * defaults             restore the default parameters
+ * counters [reset]     print or clear the health counters (not the shots)
+ * reset (r)            reset the stats
+ * page (p)             show the next display page
+ * stream               stream raw ADC samples, until the next line
+ * snap [k]             print the trigger snapshots of the k-th last shot
+ * prof [reset]         print or clear the profiling histograms, see profile.h
+ * help
+ *
+ * Parameters are the runtime settings (settings.h). This module
+ * only parses commands and updates `settings`. Applying them to
+ * the detector, the ADC, the stats and the display is up to the
+ * caller, according to the returned CMD_* actions. So, it has no
+ * hardware dependencies, and also runs on the host, see
+ * host/cmd_pty.cpp.
+ */
+
+#ifndef COMMAND_H
+#define COMMAND_H
+
+#include <stdint.h>
+
+// Longest command line, longer ones are rejected
+#define CMD_LINE_MAX 48
+
+// Actions for the caller, after a command
+#define CMD_APPLY_PEAK (1 << 0)
+#define CMD_APPLY_ADC (1 << 1)
+#define CMD_APPLY_STAT (1 << 2)
+#define CMD_RESET (1 << 3)
+#define CMD_PAGE (1 << 4)
+#define CMD_SAVE (1 << 5)
+#define CMD_STREAM (1 << 6)
+
+// Writes a part of the reply
+typedef void (*cmd_output_t)(const char *str);
+
+typedef struct {
+	char buf[CMD_LINE_MAX];
+	uint8_t len;
+	bool overflow;
+} cmd_line_t;
+
+/* Received characters, queued and drained by the main loop between
+ * shots, see chrono(). Single producer, single consumer: head and
+ * lines_in are only written by the producer, tail and lines_out by
+ * the consumer, so the producer may also be an ISR. */
+
+// Power of 2
+#define CMD_QUEUE_SIZE 128
+
+typedef struct {
+	volatile char buf[CMD_QUEUE_SIZE];
+	volatile uint8_t head, tail;
+	
+	// Line terminators queued and consumed
+	volatile uint8_t lines_in, lines_out;
+} cmd_queue_t;
+
+inline bool cmd_is_eol(char c) {
+	return c == '\n' || c == '\r';
+}
+
+inline bool cmd_queue_has_line(const cmd_queue_t &q) {
+	return q.lines_in != q.lines_out;
+}
+
+/* Room for another character. One slot is kept for a line
+ * terminator, see cmd_queue_push(). */
+inline bool cmd_queue_space(const cmd_queue_t &q) {
+	return ((q.head - q.tail) & (CMD_QUEUE_SIZE - 1)) < CMD_QUEUE_SIZE - 2;
+}
+
+// Producer only, if cmd_queue_space()
+inline void cmd_queue_push(cmd_queue_t &q, char c) {
+	q.buf[q.head] = c;
+	q.head = (q.head + 1) & (CMD_QUEUE_SIZE - 1);
+	
+	if(cmd_is_eol(c))
+		q.lines_in++;
+	
+	/* A line that fills the queue could never be drained,
+	 * so end it here. It's then rejected as too long. */
+	if(!cmd_queue_space(q) && !cmd_queue_has_line(q)) {
+		q.buf[q.head] = '\n';
+		q.head = (q.head + 1) & (CMD_QUEUE_SIZE - 1);
+		q.lines_in++;
+	}
+}
+
+// Consumer only, if not empty
+inline char cmd_queue_pop(cmd_queue_t &q) {
+	char c = q.buf[q.tail];
+	q.tail = (q.tail + 1) & (CMD_QUEUE_SIZE - 1);
+	
+	if(cmd_is_eol(c))
+		q.lines_out++;
+	
+	return c;
+}
+
+// -------------------------------------------------
+
+/* Feed a received character. Once a line is complete (CR or LF),
+ * it's executed, and its actions are returned. Otherwise returns 0. */
+uint8_t cmd_input(cmd_line_t &line, char c, cmd_output_t out);
+
+// Execute a command line, modified in place
+uint8_t cmd_exec(char *line, cmd_output_t out);
+
+#endif
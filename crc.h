@@ -0,0 +1,31 @@
+#ifndef CRC_H
+#define CRC_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Bitwise CRC-32 (IEEE 802.3, reflected, poly 0xEDB88320).
+ *
+ * Only used on small, infrequent payloads, so the 1 KB
+ * lookup table is not worth its flash/RAM. */
+
+inline uint32_t crc32_update(uint32_t crc, const void *data, size_t len) {
+	const uint8_t *p = (const uint8_t *) data;
+	
+	crc = ~crc;
+	
+	while(len--) {
+		crc ^= *p++;
+		
+		for(int i = 0; i < 8; i++)
+			crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+	}
+	
+	return ~crc;
+}
+
+inline uint32_t crc32(const void *data, size_t len) {
+	return crc32_update(0, data, len);
+}
+
+#endif
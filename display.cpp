@@ -1,31 +1,75 @@
 #include <string.h>
 #include <math.h>
 
-#include <libopencm3/stm32/i2c.h>
-#include <core/lib/mini_printf.h>
-
 #include "ssd1306/ssd1306.h"
 #include "chronograph.h"
 #include "display.h"
-
-#include <core/usb_vcp.h>
-#include <core/UART.h>
+#include "format.h"
+#include "profile.h"
 
 // -------------------------------------------------
 
-static float stdev(int count, float sum, float sqsum) {
+float stdev(int count, float sum, float sqsum) {
 	return count ? sqrt((float) (count*sqsum - sum*sum) / (count * count)) : 0;
 }
 
-static int fract_part(float num, int points) {
-	int div = pow(10, points);
-	return (int) (num * div) % div;
+static void mode_strings(chrono_mode_t mode,
+		const char **mode_str, const char **unit_str) {
+	
+	switch(mode) {
+		case mode_fps: *mode_str = "fps"; *unit_str = "fps"; break;
+		case mode_mps: *mode_str = "mps"; *unit_str = "m/s"; break;
+		case mode_joule: *mode_str = "joule"; *unit_str = "J"; break;
+		case mode_rps: *mode_str = "rps"; *unit_str = "rps"; break;
+		default: *mode_str = "?"; *unit_str = "?";
+	}
 }
 
 // -------------------------------------------------
 
+// Line buffer size, above the longest formatted line
+#define DISPLAY_LINE_MAX 32
+
+// Histogram bar area
+#define HIST_BAR_WIDTH (SSD1306_WIDTH / HIST_BINS)
+#define HIST_TOP 10
+#define HIST_BOTTOM 54
+
+// Trend chart area, newest shot on the right, one column per shot
+#define TREND_PAGE_FIRST 4
+#define TREND_PAGE_LAST 5
+#define TREND_TOP 33
+#define TREND_BOTTOM 46
+#define TREND_WIDTH SSD1306_WIDTH
+
+static_assert(TREND_WIDTH < TREND_SHOTS, "Trend chart wider than its history");
+
+static DISPLAY_PAGE page = PAGE_STAT;
+
+// What the trend chart in the screenbuffer shows
+static struct {
+	bool valid;
+	uint32_t total;
+	float low, high;
+} trend_drawn;
+
+bool display_requested;
+static uint32_t last_draw_ms;
+
+// -------------------------------------------------
+
+#if defined(PROFILE)
+static void xfer_started() { PROF_START(PROF_XFER); }
+static void xfer_finished() { PROF_STOP(PROF_XFER); }
+#endif
+
 void display_init() {
 	ssd1306_Init();
+	
+	// The transfers, from the kick until the transport is idle
+	#if defined(PROFILE)
+		ssd1306_SetTransferHooks(xfer_started, xfer_finished);
+	#endif
 }
 
 void display_write_aligned(uint8_t y, const char *str, FontDef font,
@@ -43,44 +87,225 @@ void display_write_aligned(uint8_t y, const char *str, FontDef font,
 	ssd1306_WriteString(str, font, White);
 }
 
-void display_draw_stat(chrono_stat_t stat) {
+static int trend_y(float value, float low, float high) {
+	int y = TREND_BOTTOM - (int) ((value - low)
+		* (TREND_BOTTOM - TREND_TOP) / (high - low) + 0.5f);
+	
+	if(y < TREND_TOP) y = TREND_TOP;
+	if(y > TREND_BOTTOM) y = TREND_BOTTOM;
+	
+	return y;
+}
+
+/* Column of the k-th most recent shot: a vertical span
+ * from the previous shot's point to its own. */
+static void trend_draw_column(const trend_t &trend, uint32_t k,
+		float low, float high) {
+	
+	int y = trend_y(trend_get(trend, k), low, high);
+	int y_prev = y;
+	
+	if(k + 1 < trend_count(trend))
+		y_prev = trend_y(trend_get(trend, k + 1), low, high);
+	
+	ssd1306_VLine(TREND_WIDTH - 1 - k, y_prev, y, White);
+}
+
+/* Chart of the last shots, on the histogram's range. Once that
+ * range is fixed, new shots scroll the chart left and only their
+ * columns are drawn. Otherwise the whole chart is redrawn. */
+void display_draw_trend(const chrono_stat_t &stat) {
+	const trend_t &trend = stat.trend;
+	
+	float low = stat.hist.low;
+	float high = hist_high(stat.hist);
+	
+	uint32_t added = trend.total - trend_drawn.total;
+	
+	if(trend_drawn.valid && trend.total >= trend_drawn.total
+			&& added < TREND_WIDTH
+			&& low == trend_drawn.low && high == trend_drawn.high) {
+		
+		if(added) {
+			ssd1306_ShiftLeft(0, TREND_WIDTH - 1, TREND_PAGE_FIRST,
+				TREND_PAGE_LAST, added, Black);
+		}
+		
+		for(uint32_t k = 0; k < added; k++)
+			trend_draw_column(trend, k, low, high);
+	} else {
+		uint32_t count = trend_count(trend);
+		
+		if(count > TREND_WIDTH)
+			count = TREND_WIDTH;
+		
+		ssd1306_FillPages(TREND_PAGE_FIRST, TREND_PAGE_LAST, Black);
+		
+		if(high > low) {
+			for(uint32_t k = 0; k < count; k++)
+				trend_draw_column(trend, k, low, high);
+		}
+	}
+	
+	trend_drawn = {true, trend.total, low, high};
+}
+
+void display_draw_stat(const chrono_stat_t &stat) {
 	float deviation = stdev(stat.count, stat.m_sum, stat.m_sqsum);
-	float average = (float) stat.m_sum / stat.count;
+	float average = stat.count ? stat.m_sum / stat.count : 0;
 	
 	const char *mode_str, *unit_str;
-	char buffer[129];
-	
-	switch(stat.mode) {
-		case mode_fps: mode_str = "fps"; unit_str = "fps"; break;
-		case mode_mps: mode_str = "mps"; unit_str = "m/s"; break;
-		case mode_joule: mode_str = "joule"; unit_str = "J"; break;
-		case mode_rps: mode_str = "rps"; unit_str = "rps"; break;
-		default: mode_str = "?"; unit_str = "?";
-	}
+	char header[DISPLAY_LINE_MAX], count[DISPLAY_LINE_MAX];
+	char measurement[DISPLAY_LINE_MAX];
+	char average_line[DISPLAY_LINE_MAX], deviation_line[DISPLAY_LINE_MAX];
+	char *p;
 	
-	ssd1306_Fill(Black);
+	mode_strings(stat.mode, &mode_str, &unit_str);
+	
+	// All of the text first, see PROF_FORMAT
+	PROF_START(PROF_FORMAT);
 	
-	mini_snprintf(buffer, 129, "%s | .%d", mode_str, stat.weight);
-	display_write_aligned(0, buffer, Font_6x8, ALIGN_LEFT);
+	p = fmt_str(header, mode_str);
+	p = fmt_str(p, " | .");
+	fmt_uint(p, stat.weight, 2, '0');
 	
-	mini_snprintf(buffer, 129, "%02d", stat.count);
-	display_write_aligned(0, buffer, Font_6x8, ALIGN_RIGHT);
+	fmt_uint(count, stat.count, 2, '0');
 	
 	if(stat.count)
-		mini_snprintf(buffer, 129, "%d.%02d",
-			(int) stat.measurement, fract_part(stat.measurement, 2));
+		fmt_fixed(measurement, stat.measurement, 2);
 	else
-		mini_snprintf(buffer, 129, "---");
+		fmt_str(measurement, "---");
+	
+	p = fmt_str(average_line, "Average: ");
+	p = fmt_fixed(p, average, 2);
+	p = fmt_str(p, " ");
+	fmt_str(p, unit_str);
+	
+	p = fmt_str(deviation_line, "Deviation: ");
+	p = fmt_fixed(p, deviation, 2);
+	p = fmt_str(p, " ");
+	fmt_str(p, unit_str);
+	
+	PROF_STOP(PROF_FORMAT);
+	
+	// The trend chart's pages are kept, and scrolled
+	ssd1306_FillPages(0, TREND_PAGE_FIRST - 1, Black);
+	ssd1306_FillPages(TREND_PAGE_LAST + 1, SSD1306_PAGES - 1, Black);
 	
-	display_write_aligned(20, buffer, Font_11x18, ALIGN_CENTER);
+	display_write_aligned(0, header, Font_6x8, ALIGN_LEFT);
+	display_write_aligned(0, count, Font_6x8, ALIGN_RIGHT);
+	display_write_aligned(12, measurement, Font_11x18, ALIGN_CENTER);
 	
-	mini_snprintf(buffer, 129, "Average: %d.%02d %s",
-		(int) average, fract_part(average, 2), unit_str);
-	display_write_aligned(48, buffer, Font_6x8, ALIGN_CENTER);
+	display_draw_trend(stat);
 	
-	mini_snprintf(buffer, 129, "Deviation: %d.%02d %s",
-		(int) deviation, fract_part(deviation, 2), unit_str);
-	display_write_aligned(56, buffer, Font_6x8, ALIGN_CENTER);
+	display_write_aligned(48, average_line, Font_6x8, ALIGN_CENTER);
+	display_write_aligned(56, deviation_line, Font_6x8, ALIGN_CENTER);
 	
 	ssd1306_UpdateScreen();
 }
+
+void display_draw_histogram(const chrono_stat_t &stat) {
+	const hist_t &hist = stat.hist;
+	const char *mode_str, *unit_str;
+	char header[DISPLAY_LINE_MAX], count[DISPLAY_LINE_MAX];
+	char low[DISPLAY_LINE_MAX], high[DISPLAY_LINE_MAX];
+	
+	mode_strings(stat.mode, &mode_str, &unit_str);
+	
+	// All of the text first, see PROF_FORMAT
+	PROF_START(PROF_FORMAT);
+	
+	fmt_str(fmt_str(header, mode_str), " | hist");
+	fmt_uint(count, stat.count, 2, '0');
+	fmt_int(low, hist.low);
+	fmt_int(high, hist_high(hist));
+	
+	PROF_STOP(PROF_FORMAT);
+	
+	ssd1306_Fill(Black);
+	
+	display_write_aligned(0, header, Font_6x8, ALIGN_LEFT);
+	display_write_aligned(0, count, Font_6x8, ALIGN_RIGHT);
+	
+	if(!hist.count) {
+		display_write_aligned(24, "---", Font_11x18, ALIGN_CENTER);
+		ssd1306_UpdateScreen();
+		return;
+	}
+	
+	for(int i = 0; i < HIST_BINS; i++) {
+		if(!hist.bins[i])
+			continue;
+		
+		// Non-empty bins are at least one pixel tall
+		int height = hist.bins[i] * (HIST_BOTTOM - HIST_TOP) / hist.max_bin + 1;
+		int x = i * HIST_BAR_WIDTH;
+		
+		for(int j = 0; j < HIST_BAR_WIDTH - 1; j++)
+			ssd1306_VLine(x + j, HIST_BOTTOM - height + 1, HIST_BOTTOM, White);
+	}
+	
+	display_write_aligned(56, low, Font_6x8, ALIGN_LEFT);
+	display_write_aligned(56, unit_str, Font_6x8, ALIGN_CENTER);
+	display_write_aligned(56, high, Font_6x8, ALIGN_RIGHT);
+	
+	ssd1306_UpdateScreen();
+}
+
+static void diag_line(uint8_t y, const char *label, uint32_t value, const char *unit) {
+	char buffer[DISPLAY_LINE_MAX];
+	
+	PROF_START(PROF_FORMAT);
+	fmt_str(fmt_uint(buffer, value), unit);
+	PROF_STOP(PROF_FORMAT);
+	
+	display_write_aligned(y, label, Font_6x8, ALIGN_LEFT);
+	display_write_aligned(y, buffer, Font_6x8, ALIGN_RIGHT);
+}
+
+// The health counters, see chrono_counters_t
+void display_draw_diag() {
+	ssd1306_Fill(Black);
+	
+	display_write_aligned(0, "diag", Font_6x8, ALIGN_LEFT);
+	
+	diag_line(8, "shots", counters.shots, "");
+	diag_line(16, "timeouts", counters.timeouts, "");
+	diag_line(24, "front only", counters.front_only, "");
+	diag_line(32, "suspect", counters.suspect, "");
+	diag_line(40, "max gap", CYCLES_TO_US(counters.max_gap), " us");
+	diag_line(48, "display", counters.display_us / 1000, " ms");
+	diag_line(56, "display max", CYCLES_TO_US(counters.display_max), " us");
+	
+	ssd1306_UpdateScreen();
+}
+
+void display_next_page() {
+	page = (DISPLAY_PAGE) ((page + 1) % PAGE_COUNT);
+	trend_drawn.valid = false;
+}
+
+void display_draw(const chrono_stat_t &stat) {
+	switch(page) {
+		case PAGE_HISTOGRAM: display_draw_histogram(stat); break;
+		case PAGE_DIAG: display_draw_diag(); break;
+		default: display_draw_stat(stat);
+	}
+}
+
+/* Draw the requested redraw, at most once every DISPLAY_FRAME_MS.
+ * Returns whether it drew. */
+bool display_service(const chrono_stat_t &stat, uint32_t now_ms) {
+	if(!display_requested || now_ms - last_draw_ms < DISPLAY_FRAME_MS)
+		return false;
+	
+	display_requested = false;
+	last_draw_ms = now_ms;
+	
+	// Drawing, and queueing the transfers, see PROF_XFER
+	PROF_START(PROF_DRAW);
+	display_draw(stat);
+	PROF_STOP(PROF_DRAW);
+	
+	return true;
+}
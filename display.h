@@ -4,16 +4,56 @@
 #include "ssd1306/ssd1306_fonts.h"
 #include "chronograph.h"
 
+/* Rendering is deferred: display_request() marks the display dirty,
+ * and display_service() draws the newest state once the caller is
+ * idle, so that a burst of shots costs a single redraw. */
+
+// Minimum time between redraws (ms)
+#define DISPLAY_FRAME_MS 50
+
+// Time without triggers before redrawing (ms)
+#define DISPLAY_IDLE_MS 100
+
+// -------------------------------------------------
+
 typedef enum {
 	ALIGN_LEFT,
 	ALIGN_CENTER,
 	ALIGN_RIGHT
 } DISPLAY_ALIGNMENT;
 
+typedef enum {
+	PAGE_STAT,
+	PAGE_HISTOGRAM,
+	PAGE_DIAG,
+	PAGE_COUNT
+} DISPLAY_PAGE;
+
 void display_init();
 
+// Standard deviation, from the running sums
+float stdev(int count, float sum, float sqsum);
+
 void display_write_aligned(uint8_t y, const char *str, FontDef font,
 	DISPLAY_ALIGNMENT alignment = ALIGN_LEFT);
-void display_draw_stat(chrono_stat_t stats);
+void display_draw_trend(const chrono_stat_t &stat);
+void display_draw_stat(const chrono_stat_t &stat);
+void display_draw_histogram(const chrono_stat_t &stat);
+void display_draw_diag();
+
+void display_next_page();
+void display_draw(const chrono_stat_t &stat);
+
+extern bool display_requested;
+
+inline void display_request() {
+	display_requested = true;
+}
+
+inline bool display_pending() {
+	return display_requested;
+}
+
+bool display_service(const chrono_stat_t &stat, uint32_t now_ms);
 
 #endif
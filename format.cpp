@@ -0,0 +1,95 @@
+#include <stdint.h>
+
+#include "format.h"
+
+// --------------------------------------------
+
+static const uint32_t pow10[FMT_MAX_DECIMALS + 1] = {
+	1, 10, 100, 1000, 10000, 100000, 1000000
+};
+
+/* Writes the number's digits, with an optional sign, a decimal
+ * point before the last `decimals` digits, and left padding. */
+static char *fmt_digits(char *dst, uint32_t value, bool negative,
+		uint8_t decimals, uint8_t width, char pad) {
+	
+	char digits[16];
+	int len = 0;
+	
+	do {
+		if(len == decimals && decimals)
+			digits[len++] = '.';
+		
+		digits[len++] = '0' + value % 10;
+		value /= 10;
+	} while(value || len <= decimals);
+	
+	if(negative) {
+		if(pad == '0') {
+			*dst++ = '-';
+			
+			if(width)
+				width--;
+		} else
+			digits[len++] = '-';
+	}
+	
+	for(int i = len; i < width; i++)
+		*dst++ = pad;
+	
+	while(len)
+		*dst++ = digits[--len];
+	
+	*dst = '\0';
+	return dst;
+}
+
+// --------------------------------------------
+
+char *fmt_str(char *dst, const char *str) {
+	while(*str)
+		*dst++ = *str++;
+	
+	*dst = '\0';
+	return dst;
+}
+
+char *fmt_uint(char *dst, uint32_t value, uint8_t width, char pad) {
+	return fmt_digits(dst, value, false, 0, width, pad);
+}
+
+char *fmt_int(char *dst, int32_t value, uint8_t width) {
+	uint32_t magnitude = (value < 0 ? -(uint32_t) value : value);
+	return fmt_digits(dst, magnitude, value < 0, 0, width, ' ');
+}
+
+char *fmt_fixed(char *dst, float value, uint8_t decimals, uint8_t width) {
+	if(decimals > FMT_MAX_DECIMALS)
+		decimals = FMT_MAX_DECIMALS;
+	
+	bool negative = (value < 0);
+	float magnitude = (negative ? -value : value);
+	
+	// Saturate instead of overflowing. The limit isn't always a
+	// float, so it's applied to the scaled integer.
+	const uint32_t max = (UINT32_MAX / pow10[decimals] - 1) * pow10[decimals];
+	uint32_t fixed = max;
+	
+	// 2^32, exactly (also catches NaN)
+	if(magnitude < 4294967296.0f) {
+		/* Scale the integer and fractional parts separately. Subtracting
+		 * the integer part is exact, so the fraction keeps all of the
+		 * float's precision for the rounding. */
+		uint32_t integer = magnitude;
+		float fraction = magnitude - integer;
+		
+		uint64_t scaled = (uint64_t) integer * pow10[decimals]
+			+ (uint32_t) (fraction * pow10[decimals] + 0.5f);
+		
+		if(scaled < max)
+			fixed = scaled;
+	}
+	
+	// Don't print "-0.00"
+	return fmt_digits(dst, fixed, negative && fixed, decimals, width, ' ');
+}
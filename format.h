@@ -0,0 +1,22 @@
+#ifndef FORMAT_H
+#define FORMAT_H
+
+#include <stdint.h>
+
+/* Allocation-free number formatting, writing straight into a
+ * line buffer. Each function NUL-terminates its output and returns
+ * a pointer to the terminator, so calls can be chained.
+ *
+ * Numbers are right-aligned in a field of at least `width`
+ * characters. Unlike "%d.%02d" with fract_part(), fmt_fixed()
+ * rounds to the nearest digit and handles negative values. */
+
+// Largest supported fmt_fixed() decimals
+#define FMT_MAX_DECIMALS 6
+
+char *fmt_str(char *dst, const char *str);
+char *fmt_uint(char *dst, uint32_t value, uint8_t width = 0, char pad = ' ');
+char *fmt_int(char *dst, int32_t value, uint8_t width = 0);
+char *fmt_fixed(char *dst, float value, uint8_t decimals, uint8_t width = 0);
+
+#endif
@@ -0,0 +1,52 @@
+/**
+ * Hardware abstraction of the measurement core.
+ *
+ * The implementation is selected at compile time:
+ *
+ *   hal_stm32.h       libopencm3, on the STM32F103C8 (default)
+ *   host/hal_host.h   simulated peripherals on a virtual clock,
+ *                     with CHRONO_HOST, see host/chrono_sim.cpp
+ *
+ * The functions on the sample path are inline in these headers,
+ * so the firmware compiles to the same register accesses as when
+ * they were called directly. Each implementation provides:
+ *
+ *   hal_init()                      clocks, millis(), the VCP
+ *   gpio_adc_init(), adc_init()     ADC setup
+ *   adc_channel(), adc_read()       single conversions
+ *   timer_init(), timer_read()      TIM2, counting at TIMER_FREQ,
+ *   timer_start(), timer_stop()       calls chrono_timeout_isr()
+ *                                     when it overflows
+ *   cmd_intake_init(), cmd_intake_due()
+ *                                   TIM3, without its interrupt:
+ *                                     due once per CMD_INTAKE_HZ
+ *   hal_cycles_init(), hal_cycles() cycle counter, at 72 MHz
+ *   hal_flash_page(), hal_flash_write()
+ *                                   the settings' flash page
+ *
+ * millis() and the VCP are stm32core's API (core/millis.h and
+ * core/usb_vcp.h), which the host provides in host/include. The
+ * display's transport is selected by ssd1306.h (SSD1306_USE_*).
+ */
+
+#ifndef HAL_H
+#define HAL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <core/millis.h>
+#include <core/usb_vcp.h>
+
+// -------------------------------------------------
+
+// Interrupt handlers of the measurement core, see chronograph.cpp
+void chrono_timeout_isr();
+
+#if defined(CHRONO_HOST)
+	#include "host/hal_host.h"
+#else
+	#include "hal_stm32.h"
+#endif
+
+#endif
@@ -0,0 +1,172 @@
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/gpio.h>
+#include <libopencm3/stm32/adc.h>
+#include <libopencm3/stm32/timer.h>
+#include <libopencm3/stm32/flash.h>
+#include <libopencm3/cm3/nvic.h>
+
+#include <string.h>
+
+#include "hal.h"
+#include "chronograph.h"
+
+// --------------------------------------------
+
+int main() {
+	hal_init();
+	chrono_main();
+}
+
+extern "C" void tim2_isr(void) {
+	if(timer_get_flag(TIM2, TIM_SR_UIF)) {
+		timer_clear_flag(TIM2, TIM_SR_UIF);
+		chrono_timeout_isr();
+	}
+}
+
+// --------------------------------------------
+
+void hal_init() {
+	rcc_clock_setup_in_hse_8mhz_out_72mhz();
+	
+	millis_init();
+	vcp_init();
+}
+
+void adc_init(uint8_t sample_time, uint8_t prescaler) {
+	rcc_periph_clock_enable(RCC_ADC1);
+	
+	/* RCC_CFGR_ADCPRE_PCLK2_DIV2..8 are 0..3. The default
+	 * settings.adc_prescaler is 2 (RCC_CFGR_ADCPRE_PCLK2_DIV2) */
+	rcc_set_adcpre(prescaler/2 - 1);
+	
+	adc_power_off(ADC1);
+	rcc_periph_reset_pulse(RST_ADC1);
+	
+	/* These measurements include the time for the peak detection
+	 * algorithm to work, and are obtained with an ADC prescaler
+	 * value of 2 (RCC_CFGR_ADCPRE_PCLK2_DIV2) unless otherwise
+	 * specified, and varying sample times.
+	 *
+	 * Initially, the smallest possible sampling time, 1DOT5CYC, was
+	 * used. It gave 1.7 us sampling time, but the measurements were
+	 * pretty unstable. (perhaps also because of external factors
+	 * belonging in the magestic realm of analog electronics)
+	 *
+	 * We can actually go higher with our sampling times. The main
+	 * limiting factor is the maximum projectile speed we wish to
+	 * measure, coupled with the sensing distance of our diodes.
+	 * Is some cases, if the peak detection algorithm, has an
+	 * "on-the-fly" training period the diode distance could also
+	 * affect the sampling time.
+	 *
+	 * With ADC_SMPR_SMP_28DOT5CYC, we get 2.4us/sample, and the
+	 * measurement are already much more stable. But, we can go
+	 * even higher.
+	 *
+	 * While this is unconfirmed/untested, we would wish to have
+	 * higher sampling cycles because we appear to get more stable
+	 * values this way. More stable values allow us to have higher
+	 * tolerances in our peak detection, which in turn can help
+	 * translate into higher sensitivity (so more user friendliness),
+	 * along with higher accuracy.
+	 *
+	 * With my specific 3D-printed chrono case, I measured the detection
+	 * area to be between 3~5 mm. Assuming a maximum measurement speed
+	 * of ~250 m/s (820 fps), supposing the worst case of 3 mm, a speed
+	 * of 250 m/s, and a mininum required amount of 2 samples, we arrive
+	 * at a sampling time of 5-6 us.
+	 *
+	 * ADC_SMPR_SMP_71DOT5CYC gives a sample time of 3.6 us.
+	 * ADC_SMPR_SMP_239DOT5CYC gives a sample time of 8.4 us.
+	 *
+	 * ADC_SMPR_SMP_71DOT5CYC and RCC_CFGR_ADCPRE_PCLK2_DIV4
+	 * give a sample time of 6 us.
+	 *
+	 * However, there also other concerns when choosing high sample times:
+	 * 1. If the trigger is off by even one sample, a higher speed fault
+	 *   will be introduced compared to a smaller sample time.
+	 * 2. Does it even make sense trying to read a stable measurement,
+	 *   if the environment is volatile whilst sampling it?
+	 *
+	 * Regarding point (1), at 100 m/s, 1 sample's fault is worth:
+	 *   At 2.4us/sample, 0.8 m/s or 2.6 fps
+	 *   At 6us/sample, 2 m/s or 6.5 fps
+	 *   At 8us/sample, 2.6 m/s or 8.5 fps
+	 *
+	 * The sample time and prescaler are runtime settings, defaulting
+	 * to ADC_SMPR_SMP_28DOT5CYC and RCC_CFGR_ADCPRE_PCLK2_DIV2.
+	 * settings_validate() rejects values that violate the
+	 * 3 mm / 250 m/s / 2 samples limit above.
+	 */
+	
+	adc_set_sample_time_on_all_channels(ADC1, sample_time);
+	adc_enable_external_trigger_regular(ADC1, ADC_CR2_EXTSEL_SWSTART);
+	
+	adc_power_on(ADC1);
+	
+	for(int i = 0; i < 50; i++)
+		__asm__("nop");
+	
+	adc_reset_calibration(ADC1);
+	adc_calibrate(ADC1);
+}
+
+void gpio_adc_init() {
+    rcc_periph_clock_enable(RCC_GPIOA);
+    gpio_set_mode(GPIOA, GPIO_MODE_INPUT, GPIO_CNF_INPUT_ANALOG, GPIO0);
+    gpio_set_mode(GPIOA, GPIO_MODE_INPUT, GPIO_CNF_INPUT_ANALOG, GPIO1);
+}
+
+void timer_init() {
+	rcc_periph_clock_enable(RCC_TIM2);
+	rcc_periph_reset_pulse(RST_TIM2);
+	
+	timer_set_prescaler(TIM2, (rcc_apb1_frequency * 2) / TIMER_FREQ);
+	timer_set_period(TIM2, TIMER_ARR);
+	timer_one_shot_mode(TIM2);
+	
+	/* For some reason, the first time the counter is enabled,
+	 * a UEV is generated immediately. So, we handle this here. */
+	timer_set_counter(TIM2, TIMER_ARR);
+	timer_enable_counter(TIM2);
+	while(!timer_get_flag(TIM2, TIM_SR_UIF));
+	timer_clear_flag(TIM2, TIM_SR_UIF);
+	
+	nvic_enable_irq(NVIC_TIM2_IRQ);
+	timer_enable_irq(TIM2, TIM_DIER_UIE);
+}
+
+void cmd_intake_init() {
+	rcc_periph_clock_enable(RCC_TIM3);
+	rcc_periph_reset_pulse(RST_TIM3);
+	
+	// 1 MHz counter
+	timer_set_prescaler(TIM3, (rcc_apb1_frequency * 2) / 1000000 - 1);
+	timer_set_period(TIM3, 1000000 / CMD_INTAKE_HZ - 1);
+	timer_continuous_mode(TIM3);
+	
+	// Polled, see cmd_intake_due()
+	timer_enable_counter(TIM3);
+}
+
+// --------------------------------------------
+
+const void *hal_flash_page() {
+	return (const void *) HAL_FLASH_PAGE_ADDR;
+}
+
+// Erase the page, program it, and verify
+bool hal_flash_write(const void *src, size_t len) {
+	const uint16_t *data = (const uint16_t *) src;
+	
+	flash_unlock();
+	flash_erase_page(HAL_FLASH_PAGE_ADDR);
+	
+	for(size_t i = 0; i < len / 2; i++)
+		flash_program_half_word(HAL_FLASH_PAGE_ADDR + i*2, data[i]);
+	
+	flash_lock();
+	
+	return memcmp(hal_flash_page(), src, len) == 0;
+}
@@ -0,0 +1,72 @@
+#ifndef HAL_STM32_H
+#define HAL_STM32_H
+
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/adc.h>
+#include <libopencm3/stm32/timer.h>
+#include <libopencm3/cm3/nvic.h>
+#include <libopencm3/cm3/dwt.h>
+
+/* STM32F103C8 HAL, see hal.h. The ISRs, and everything that's
+ * not on the sample path, are in hal_stm32.cpp. */
+
+// Last 1 KB page of the 64 KB flash, holds the settings
+#define HAL_FLASH_PAGE_ADDR 0x0800FC00
+
+// -------------------------------------------------
+
+void hal_init();
+
+void gpio_adc_init();
+void adc_init(uint8_t sample_time, uint8_t prescaler);
+
+void timer_init();
+void cmd_intake_init();
+
+const void *hal_flash_page();
+bool hal_flash_write(const void *src, size_t len);
+
+// -------------------------------------------------
+
+inline void adc_channel(uint8_t channel) {
+	adc_set_regular_sequence(ADC1, 1, &channel);
+}
+
+inline uint32_t adc_read() {
+	adc_start_conversion_regular(ADC1);
+	while(!adc_eoc(ADC1));
+	
+	return adc_read_regular(ADC1);
+}
+
+inline uint16_t timer_read() {
+	return timer_get_counter(TIM2);
+}
+
+inline void timer_start() {
+	timer_set_counter(TIM2, 0);
+	timer_enable_counter(TIM2);
+}
+
+inline void timer_stop() {
+	timer_disable_counter(TIM2);
+}
+
+// TIM3 updated since the last call
+inline bool cmd_intake_due() {
+	if(!timer_get_flag(TIM3, TIM_SR_UIF))
+		return false;
+	
+	timer_clear_flag(TIM3, TIM_SR_UIF);
+	return true;
+}
+
+inline void hal_cycles_init() {
+	dwt_enable_cycle_counter();
+}
+
+inline uint32_t hal_cycles() {
+	return dwt_read_cycle_counter();
+}
+
+#endif
@@ -0,0 +1,106 @@
+/**
+ * Fixed-bin histogram of the measurements.
+ *
+ * The bin range is derived from the first HIST_TRAINING
+ * measurements, and is fixed afterwards. Measurements outside
+ * of the range are counted in the first/last bin.
+ *
+ * Updating is O(1), apart from the training period,
+ * during which at most HIST_TRAINING values are re-binned,
+ * and the rare halving of all bins, before one overflows.
+ */
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdint.h>
+
+#define HIST_BINS 32
+#define HIST_TRAINING 5
+
+// Minimum range, relative to the center (percent)
+#define HIST_MIN_SPAN_PCT 10
+
+typedef struct {
+	float low;
+	float bin_width;
+
+	uint16_t bins[HIST_BINS];
+	uint16_t max_bin;
+
+	uint16_t count;
+	float training[HIST_TRAINING];
+} hist_t;
+
+inline void hist_reset(hist_t &h) {
+	h = {};
+}
+
+inline float hist_high(const hist_t &h) {
+	return h.low + h.bin_width * HIST_BINS;
+}
+
+inline void hist_bin_add(hist_t &h, float value) {
+	int bin = (value - h.low) / h.bin_width;
+
+	if(bin < 0) bin = 0;
+	if(bin >= HIST_BINS) bin = HIST_BINS - 1;
+
+	// Keeps the shape. Rounded up, so that no bin empties.
+	if(h.bins[bin] == UINT16_MAX) {
+		for(int i = 0; i < HIST_BINS; i++)
+			h.bins[i] = (h.bins[i] + 1) / 2;
+
+		h.max_bin = (h.max_bin + 1) / 2;
+	}
+
+	if(++h.bins[bin] > h.max_bin)
+		h.max_bin = h.bins[bin];
+}
+
+/* Place the range around the training values. The range
+ * is twice their spread, and at least HIST_MIN_SPAN_PCT
+ * of their center, so that the later shots fit in it. */
+inline void hist_train(hist_t &h) {
+	float min = h.training[0], max = h.training[0];
+
+	for(int i = 1; i < h.count; i++) {
+		if(h.training[i] < min) min = h.training[i];
+		if(h.training[i] > max) max = h.training[i];
+	}
+
+	float center = (min + max) / 2;
+	float span = (max - min) * 2;
+	float min_span = center * HIST_MIN_SPAN_PCT / 100;
+
+	if(span < min_span)
+		span = min_span;
+
+	if(span <= 0)
+		span = 1;
+
+	h.low = center - span / 2;
+	h.bin_width = span / HIST_BINS;
+
+	h.max_bin = 0;
+
+	for(int i = 0; i < HIST_BINS; i++)
+		h.bins[i] = 0;
+
+	for(int i = 0; i < h.count; i++)
+		hist_bin_add(h, h.training[i]);
+}
+
+inline void hist_add(hist_t &h, float value) {
+	if(h.count < HIST_TRAINING) {
+		h.training[h.count++] = value;
+		hist_train(h);
+	} else {
+		if(h.count < UINT16_MAX)
+			h.count++;
+
+		hist_bin_add(h, value);
+	}
+}
+
+#endif
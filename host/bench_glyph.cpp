@@ -0,0 +1,110 @@
+/**
+ * Glyph rendering benchmark: the page blitter of ssd1306_WriteChar()
+ * versus the previous per-pixel renderer, which is reproduced here
+ * on top of ssd1306_DrawPixel(). The output of both is compared,
+ * for page-aligned and unaligned rows.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+
+#include "../ssd1306/ssd1306.h"
+#include "../ssd1306/ssd1306_fonts.h"
+
+// -------------------------------------------------
+
+static void write_char_pixels(char ch, uint8_t x, uint8_t y,
+		FontDef font, SSD1306_COLOR color) {
+	
+	for(int i = 0; i < font.FontHeight; i++) {
+		uint32_t b = font.data[(ch - 32) * font.FontHeight + i];
+		
+		for(int j = 0; j < font.FontWidth; j++) {
+			ssd1306_DrawPixel(x + j, y + i, ((b << j) & 0x8000)
+				? color : (SSD1306_COLOR) !color);
+		}
+	}
+}
+
+static void write_char_blit(char ch, uint8_t x, uint8_t y,
+		FontDef font, SSD1306_COLOR color) {
+	
+	ssd1306_SetCursor(x, y);
+	ssd1306_WriteChar(ch, font, color);
+}
+
+typedef void (*render_fn)(char, uint8_t, uint8_t, FontDef, SSD1306_COLOR);
+
+static void render(render_fn fn, FontDef font, uint8_t y, SSD1306_COLOR color) {
+	uint8_t x = 0;
+	
+	ssd1306_Fill(color == White ? Black : White);
+	
+	for(char ch = 32; ch <= 126; ch++) {
+		if(x + font.FontWidth > SSD1306_WIDTH)
+			x = 0;
+		
+		fn(ch, x, y, font, color);
+		x += font.FontWidth;
+	}
+}
+
+static bool check(FontDef font, uint8_t y, SSD1306_COLOR color) {
+	uint8_t expected[SSD1306_WIDTH * SSD1306_HEIGHT / 8];
+	
+	render(write_char_pixels, font, y, color);
+	memcpy(expected, ssd1306_GetBuffer(), sizeof(expected));
+	
+	render(write_char_blit, font, y, color);
+	
+	return memcmp(expected, ssd1306_GetBuffer(), sizeof(expected)) == 0;
+}
+
+static double bench(render_fn fn, FontDef font, uint8_t y, int iterations) {
+	auto start = std::chrono::steady_clock::now();
+	
+	for(int i = 0; i < iterations; i++)
+		fn('0' + i % 10, (i * font.FontWidth) % (SSD1306_WIDTH - font.FontWidth), y, font, White);
+	
+	auto end = std::chrono::steady_clock::now();
+	
+	return std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+}
+
+// -------------------------------------------------
+
+int main() {
+	const struct { const char *name; FontDef *font; } fonts[] = {
+		{"6x8", &Font_6x8}, {"7x10", &Font_7x10},
+		{"11x18", &Font_11x18}, {"16x26", &Font_16x26}
+	};
+	
+	const uint8_t rows[] = {16, 21};
+	const SSD1306_COLOR colors[] = {White, Black};
+	
+	const int iterations = 1000000;
+	bool ok = true;
+	
+	ssd1306_Init();
+	
+	printf("%-6s %-4s %12s %12s %8s\n", "font", "y", "pixel(ns)", "blit(ns)", "speedup");
+	
+	for(auto &f : fonts) {
+		for(uint8_t y : rows) {
+			for(SSD1306_COLOR color : colors) {
+				if(!check(*f.font, y, color)) {
+					printf("MISMATCH font %s y %d color %d\n", f.name, y, color);
+					ok = false;
+				}
+			}
+			
+			double pixel = bench(write_char_pixels, *f.font, y, iterations);
+			double blit = bench(write_char_blit, *f.font, y, iterations);
+			
+			printf("%-6s %-4d %12.1f %12.1f %7.1fx\n", f.name, y, pixel, blit, pixel / blit);
+		}
+	}
+	
+	return ok ? 0 : 1;
+}
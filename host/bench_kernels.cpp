@@ -0,0 +1,339 @@
+/**
+ * Hot-path kernel microbenchmarks.
+ *
+ * Times the kernels of the sample loop and of the display, on the
+ * host: peak_detect(), calc_speed(), stdev(), fmt_fixed() (which
+ * replaced fract_part()), ssd1306_WriteChar() and
+ * ssd1306_UpdateScreen(), of an unchanged and of a fully changed
+ * frame. The display's transport is a stub, that completes the
+ * queued transfers at once, so only the library's own cost is
+ * measured.
+ *
+ * Each kernel runs over a fixed, pseudo-random input set. After a
+ * warm-up run, it's timed over a number of repetitions, and the
+ * time per call is reported (min, median, mean, standard deviation,
+ * max), as JSON on stdout, one kernel per line.
+ *
+ * With -c, the medians are compared to a previous output, and the
+ * kernels more than -t percent slower are reported on stderr,
+ * failing the run. Host timings are only comparable on the same
+ * machine and compiler.
+ *
+ * Usage: bench_kernels [-q] [-r repetitions] [-c baseline.json] [-t percent]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <vector>
+#include <algorithm>
+
+#include "../settings.h"
+#include "../display.h"
+#include "../format.h"
+#include "../peak.h"
+#include "../ssd1306/ssd1306.h"
+
+// -------------------------------------------------
+
+// Null transport (SSD1306_USE_HOST)
+
+void ssd1306_TransportInit(void) {}
+void ssd1306_Reset(void) {}
+
+void ssd1306_TransportKick(void) {
+	while(ssd1306_TransferPeek())
+		ssd1306_TransferDone();
+}
+
+// -------------------------------------------------
+
+float calc_speed(uint16_t ticks);
+
+// Inputs, per kernel call
+#define INPUTS 4096
+
+// Results are summed here, so that the calls aren't optimized out
+static volatile uint32_t sink;
+
+static uint32_t rng_state = 1;
+
+static uint32_t rng() {
+	rng_state = rng_state * 1664525 + 1013904223;
+	return rng_state >> 8;
+}
+
+typedef struct {
+	const char *name;
+	
+	// Runs calls calls, cycling over the inputs
+	void (*run)(uint32_t calls);
+	
+	uint32_t calls;
+} kernel_t;
+
+typedef struct {
+	double min, median, mean, stdev, max;
+} stats_t;
+
+// -------------------------------------------------
+
+static uint16_t adc_samples[INPUTS];
+
+// Baseline noise, with a pulse every 512 samples
+static void init_adc_samples() {
+	for(int i = 0; i < INPUTS; i++) {
+		adc_samples[i] = 2000 + rng() % 8;
+		
+		if(i % 512 < 6)
+			adc_samples[i] += 300;
+	}
+}
+
+static void run_peak_detect(uint32_t calls) {
+	static uint16_t samples[PEAK_LAG_MAX];
+	peak_stat_t s;
+	uint32_t peaks = 0;
+	
+	peak_stat_init(s, PEAK_THRESHOLD, PEAK_INFLUENCE, PEAK_LAG, samples);
+	
+	for(uint32_t i = 0; i < calls; i++)
+		peaks += peak_detect(s, adc_samples[i % INPUTS]);
+	
+	sink += peaks;
+}
+
+static uint16_t ticks[INPUTS];
+
+static void run_calc_speed(uint32_t calls) {
+	float sum = 0;
+	
+	for(uint32_t i = 0; i < calls; i++)
+		sum += calc_speed(ticks[i % INPUTS]);
+	
+	sink += (uint32_t) sum;
+}
+
+static float values[INPUTS];
+
+// A series' count and sums, as chrono_stat_update() keeps them
+typedef struct {
+	int count;
+	float sum;
+	float sqsum;
+} series_t;
+
+static series_t series[INPUTS];
+
+// Series of 1 to 100 shots, of 280 to 320 fps. Rounding takes the
+// variance of a few (equal shots) below zero; those are drawn again.
+static void init_series() {
+	for(int i = 0; i < INPUTS; i++) {
+		series_t &s = series[i];
+		
+		do {
+			s = {.count = (int) (1 + rng() % 100)};
+			
+			for(int c = 0; c < s.count; c++) {
+				float measurement = 280 + (rng() % 4000) / 100.0f;
+				
+				s.sum += measurement;
+				s.sqsum += measurement*measurement;
+			}
+		} while(s.count*s.sqsum - s.sum*s.sum < 0);
+	}
+}
+
+static void run_stdev(uint32_t calls) {
+	float sum = 0;
+	
+	for(uint32_t i = 0; i < calls; i++) {
+		const series_t &s = series[i % INPUTS];
+		sum += stdev(s.count, s.sum, s.sqsum);
+	}
+	
+	sink += (uint32_t) sum;
+}
+
+static void run_fmt_fixed(uint32_t calls) {
+	char buffer[32];
+	uint32_t len = 0;
+	
+	for(uint32_t i = 0; i < calls; i++)
+		len += fmt_fixed(buffer, values[i % INPUTS], 2) - buffer;
+	
+	sink += len;
+}
+
+// Unaligned rows, as the stat page's
+static void run_write_char(uint32_t calls) {
+	for(uint32_t i = 0; i < calls; i++) {
+		ssd1306_SetCursor((i * 7) % (SSD1306_WIDTH - 7), 21 + i % 3);
+		ssd1306_WriteChar('0' + i % 10, Font_7x10, White);
+	}
+	
+	sink += ssd1306_GetBuffer()[SSD1306_WIDTH * 3];
+}
+
+// Nothing changed, only the dirty tracking
+static void run_update_idle(uint32_t calls) {
+	for(uint32_t i = 0; i < calls; i++)
+		ssd1306_UpdateScreen();
+	
+	sink += ssd1306_IsBusy();
+}
+
+// Every byte changed, including the ssd1306_Fill()
+static void run_update_full(uint32_t calls) {
+	for(uint32_t i = 0; i < calls; i++) {
+		ssd1306_Fill(i % 2 ? White : Black);
+		ssd1306_UpdateScreen();
+	}
+	
+	sink += ssd1306_IsBusy();
+}
+
+static const kernel_t kernels[] = {
+	{"peak_detect", run_peak_detect, 1000000},
+	{"calc_speed", run_calc_speed, 1000000},
+	{"stdev", run_stdev, 1000000},
+	{"fmt_fixed", run_fmt_fixed, 1000000},
+	{"ssd1306_WriteChar", run_write_char, 200000},
+	{"ssd1306_UpdateScreen/idle", run_update_idle, 1000000},
+	{"ssd1306_UpdateScreen/full", run_update_full, 100000},
+};
+
+// -------------------------------------------------
+
+static double time_ns(const kernel_t &k, uint32_t calls) {
+	auto start = std::chrono::steady_clock::now();
+	k.run(calls);
+	auto end = std::chrono::steady_clock::now();
+	
+	return std::chrono::duration<double, std::nano>(end - start).count() / calls;
+}
+
+static stats_t bench(const kernel_t &k, uint32_t calls, int repetitions) {
+	std::vector<double> times;
+	stats_t st = {};
+	
+	// Warm-up: caches, branch predictors, page faults
+	time_ns(k, calls);
+	
+	for(int r = 0; r < repetitions; r++)
+		times.push_back(time_ns(k, calls));
+	
+	std::sort(times.begin(), times.end());
+	
+	for(double t : times)
+		st.mean += t;
+	
+	st.mean /= times.size();
+	
+	for(double t : times)
+		st.stdev += (t - st.mean) * (t - st.mean);
+	
+	st.stdev = sqrt(st.stdev / times.size());
+	
+	st.min = times.front();
+	st.max = times.back();
+	st.median = times[times.size() / 2];
+	
+	return st;
+}
+
+// Median of a kernel in a previous output, or < 0
+static double baseline_median(FILE *f, const char *name) {
+	char line[512], found[64];
+	double median;
+	
+	rewind(f);
+	
+	while(fgets(line, sizeof(line), f)) {
+		const char *p = strstr(line, "{\"name\": ");
+		
+		if(p && sscanf(p, "{\"name\": \"%63[^\"]\", \"median_ns\": %lf", found, &median) == 2
+				&& strcmp(found, name) == 0)
+			return median;
+	}
+	
+	return -1;
+}
+
+static int usage(const char *name) {
+	fprintf(stderr, "Usage: %s [-q] [-r repetitions] [-c baseline.json] [-t percent]\n", name);
+	return 2;
+}
+
+int main(int argc, char *argv[]) {
+	int repetitions = 15, divisor = 1, opt;
+	const char *baseline_path = NULL;
+	double tolerance = 10;
+	
+	while((opt = getopt(argc, argv, "qr:c:t:")) != -1) {
+		switch(opt) {
+			case 'q': divisor = 10; break;
+			case 'r': repetitions = atoi(optarg); break;
+			case 'c': baseline_path = optarg; break;
+			case 't': tolerance = atof(optarg); break;
+			
+			default: return usage(argv[0]);
+		}
+	}
+	
+	if(repetitions < 1)
+		return usage(argv[0]);
+	
+	FILE *baseline = NULL;
+	
+	if(baseline_path && !(baseline = fopen(baseline_path, "r"))) {
+		perror(baseline_path);
+		return 1;
+	}
+	
+	settings_defaults(settings);
+	ssd1306_Init();
+	
+	init_adc_samples();
+	init_series();
+	
+	for(int i = 0; i < INPUTS; i++) {
+		ticks[i] = 1000 + rng() % 60000;
+		values[i] = (rng() % 1000000) / 1000.0f;
+	}
+	
+	printf("{\"benchmark\": \"kernels\", \"repetitions\": %d, \"kernels\": [\n", repetitions);
+	
+	int regressions = 0;
+	size_t n = sizeof(kernels) / sizeof(*kernels);
+	
+	for(size_t i = 0; i < n; i++) {
+		const kernel_t &k = kernels[i];
+		uint32_t calls = k.calls / divisor;
+		stats_t st = bench(k, calls, repetitions);
+		
+		printf("  {\"name\": \"%s\", \"median_ns\": %.3f, \"min_ns\": %.3f, "
+			"\"mean_ns\": %.3f, \"stdev_ns\": %.3f, \"max_ns\": %.3f, \"calls\": %u}%s\n",
+			k.name, st.median, st.min, st.mean, st.stdev, st.max, calls,
+			i + 1 < n ? "," : "");
+		
+		double base = (baseline ? baseline_median(baseline, k.name) : -1);
+		
+		if(base > 0 && st.median > base * (1 + tolerance / 100)) {
+			fprintf(stderr, "%s: %.3f ns, was %.3f ns (+%.1f%%)\n", k.name,
+				st.median, base, (st.median / base - 1) * 100);
+			regressions++;
+		}
+	}
+	
+	printf("]}\n");
+	
+	if(baseline)
+		fclose(baseline);
+	
+	return (regressions ? 1 : 0);
+}
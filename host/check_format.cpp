@@ -0,0 +1,204 @@
+/**
+ * Number formatting check.
+ *
+ * Sweeps fmt_uint(), fmt_int() and fmt_fixed() (format.cpp) over
+ * values, widths and decimals, and compares each result with the
+ * same field from snprintf(): "%*u", "%0*u", "%*d" and "%*.*f".
+ *
+ * fmt_fixed() differs on purpose in two ways. It rounds half up, on
+ * the float's scaled fraction, so values within its rounding error
+ * of a midpoint may end one unit from printf's exact rounding. And
+ * values that round to zero print without a sign, not "-0.00".
+ * Magnitudes past UINT32_MAX / 10^decimals - 1, infinities and NaN
+ * saturate at that value.
+ *
+ * Usage: check_format [-n fixed_values]
+ *
+ * Exits with 1 on any mismatch, printing the first few.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <float.h>
+#include <unistd.h>
+
+#include <random>
+
+#include "../format.h"
+
+// -------------------------------------------------
+
+// Widest field checked
+#define WIDTH_MAX 12
+
+// Mismatches printed
+#define REPORT_MAX 10
+
+static uint64_t checks, failures;
+
+static void mismatch(const char *call, const char *got, const char *expected) {
+	if(++failures <= REPORT_MAX)
+		printf("FAIL %s: \"%s\", expected \"%s\"\n", call, got, expected);
+}
+
+static void check_uint(uint32_t value) {
+	char got[32], expected[32], call[64];
+	
+	for(int width = 0; width <= WIDTH_MAX; width++) {
+		fmt_uint(got, value, width);
+		snprintf(expected, sizeof(expected), "%*u", width, value);
+		checks++;
+		
+		if(strcmp(got, expected) != 0) {
+			snprintf(call, sizeof(call), "fmt_uint(%u, %d)", value, width);
+			mismatch(call, got, expected);
+		}
+		
+		fmt_uint(got, value, width, '0');
+		snprintf(expected, sizeof(expected), "%0*u", width, value);
+		checks++;
+		
+		if(strcmp(got, expected) != 0) {
+			snprintf(call, sizeof(call), "fmt_uint(%u, %d, '0')", value, width);
+			mismatch(call, got, expected);
+		}
+	}
+}
+
+static void check_int(int32_t value) {
+	char got[32], expected[32], call[64];
+	
+	for(int width = 0; width <= WIDTH_MAX; width++) {
+		fmt_int(got, value, width);
+		snprintf(expected, sizeof(expected), "%*d", width, value);
+		checks++;
+		
+		if(strcmp(got, expected) != 0) {
+			snprintf(call, sizeof(call), "fmt_int(%d, %d)", value, width);
+			mismatch(call, got, expected);
+		}
+	}
+}
+
+// Within fmt_fixed()'s float rounding error of a midpoint
+static bool near_midpoint(float value, int decimals) {
+	double scaled = fabs((double) value) * pow(10, decimals);
+	double fraction = scaled - floor(scaled);
+	
+	return fabs(fraction - 0.5) <= pow(10, decimals) * 1.2e-7 + 1e-9;
+}
+
+// fmt_fixed()'s saturation, the largest integer part it prints
+static double fixed_limit(int decimals) {
+	uint32_t scale = (uint32_t) pow(10, decimals);
+	return UINT32_MAX / scale - 1;
+}
+
+static void check_fixed(float value) {
+	char got[32], expected[32], call[64];
+	
+	for(int decimals = 0; decimals <= FMT_MAX_DECIMALS; decimals++) {
+		// Saturated, also NaN, with the sign of value < 0
+		double limit = fixed_limit(decimals);
+		double clamped = (fabs(value) < limit ? value : value < 0 ? -limit : limit);
+		
+		for(int width = 0; width <= WIDTH_MAX; width++) {
+			fmt_fixed(got, value, decimals, width);
+			snprintf(expected, sizeof(expected), "%*.*f", width, decimals, clamped);
+			checks++;
+			
+			// No "-0.00"
+			if(strchr(expected, '-') && atof(expected) == 0)
+				snprintf(expected, sizeof(expected), "%*.*f", width, decimals, 0.0);
+			
+			if(strcmp(got, expected) == 0)
+				continue;
+			
+			// One unit off, at a midpoint
+			double unit = pow(10, -decimals);
+			
+			if(near_midpoint(value, decimals) && fabs(atof(got) - atof(expected)) < unit * 1.5)
+				continue;
+			
+			snprintf(call, sizeof(call), "fmt_fixed(%.9g, %d, %d)", value, decimals, width);
+			mismatch(call, got, expected);
+		}
+	}
+}
+
+int main(int argc, char *argv[]) {
+	long num_fixed = 50000;
+	int opt;
+	
+	while((opt = getopt(argc, argv, "n:")) != -1) {
+		switch(opt) {
+			case 'n': num_fixed = atol(optarg); break;
+			
+			default:
+				fprintf(stderr, "Usage: %s [-n fixed_values]\n", argv[0]);
+				return 2;
+		}
+	}
+	
+	// Every value up to 10^5, and around the powers of 10 and the limits
+	for(uint32_t v = 0; v <= 100000; v++)
+		check_uint(v);
+	
+	for(uint64_t p = 10; p <= UINT32_MAX; p *= 10) {
+		for(uint64_t v = p - 2; v <= p + 2; v++)
+			check_uint(v);
+	}
+	
+	for(uint32_t v = UINT32_MAX - 2; v != 0; v++)
+		check_uint(v);
+	
+	for(int32_t v = -100000; v <= 100000; v++)
+		check_int(v);
+	
+	const int32_t int_limits[] = {INT32_MIN, INT32_MIN + 1, INT32_MAX - 1, INT32_MAX};
+	
+	for(int32_t v : int_limits)
+		check_int(v);
+	
+	// Values as the display prints them, e.g. "0.50", "-3.25", "199.99"
+	for(int32_t v = -20000; v <= 20000; v++)
+		check_fixed(v / 100.0f);
+	
+	// Random magnitudes, of either sign, below fmt_fixed()'s saturation
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<float> exponent(-7, 3);
+	
+	for(long i = 0; i < num_fixed; i++) {
+		float value = powf(10, exponent(rng));
+		check_fixed(rng() & 1 ? -value : value);
+	}
+	
+	// At, and around, the saturation limits, and beyond
+	for(int decimals = 0; decimals <= FMT_MAX_DECIMALS; decimals++) {
+		float value = fixed_limit(decimals);
+		
+		for(int i = 0; i < 8; i++)
+			value = nextafterf(value, 0);
+		
+		for(int i = 0; i < 16; i++) {
+			check_fixed(value);
+			check_fixed(-value);
+			value = nextafterf(value, INFINITY);
+		}
+	}
+	
+	const float beyond[] = {4294967040.0f, 4294967296.0f, 1e10f, FLT_MAX, INFINITY, NAN};
+	
+	for(float v : beyond) {
+		check_fixed(v);
+		check_fixed(-v);
+	}
+	
+	printf("%llu checks, %llu failed\n",
+		(unsigned long long) checks, (unsigned long long) failures);
+	
+	return failures ? 1 : 0;
+}
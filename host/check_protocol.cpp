@@ -0,0 +1,102 @@
+/**
+ * Record framing check.
+ *
+ * Frames records of every length up to PROTO_RECORD_MAX with
+ * proto_encode() (protocol.h), and decodes them back. Then feeds
+ * proto_decode() and cobs_decode() malformed frames: a flipped
+ * bit, a zero inside the frame, and over-long frames, which must
+ * be rejected without writing past the destination.
+ *
+ * Usage: check_protocol
+ *
+ * Exits with 1 on any failure, printing it.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#include <random>
+
+#include "../protocol.h"
+
+// -------------------------------------------------
+
+// Bytes past the destination, that must stay untouched
+#define GUARD 16
+#define GUARD_BYTE 0xA5
+
+static int checks, failures;
+
+static void check(bool ok, const char *what, size_t len) {
+	checks++;
+	
+	if(!ok) {
+		printf("FAIL %s, length %zu\n", what, len);
+		failures++;
+	}
+}
+
+// cobs_decode() into a buffer of cap bytes, followed by a guard
+static int decode_guarded(const uint8_t *src, size_t len, size_t cap, bool &guard_ok) {
+	uint8_t dst[PROTO_FRAME_MAX + GUARD];
+	
+	memset(dst, GUARD_BYTE, sizeof(dst));
+	int n = cobs_decode(src, len, dst, cap);
+	
+	guard_ok = true;
+	
+	for(size_t i = cap; i < cap + GUARD; i++)
+		guard_ok &= (dst[i] == GUARD_BYTE);
+	
+	return n;
+}
+
+int main() {
+	uint8_t record[PROTO_RECORD_MAX], decoded[PROTO_RECORD_MAX];
+	uint8_t frame[PROTO_FRAME_MAX];
+	std::mt19937 rng(1);
+	
+	for(size_t len = 1; len <= PROTO_RECORD_MAX; len++) {
+		// Random bytes, with plenty of zeros
+		for(size_t i = 0; i < len; i++)
+			record[i] = (rng() % 4 ? rng() : 0);
+		
+		size_t n = proto_encode(record, len, frame);
+		check(n <= PROTO_FRAME_MAX, "frame larger than PROTO_FRAME_MAX", len);
+		
+		// Without the delimiters
+		int m = proto_decode(frame + 1, n - 2, decoded);
+		check(m == (int) len && memcmp(record, decoded, len) == 0, "round trip", len);
+		
+		frame[1 + rng() % (n - 2)] ^= 1 << (rng() % 8);
+		check(proto_decode(frame + 1, n - 2, decoded) == -1, "flipped bit accepted", len);
+		
+		proto_encode(record, len, frame);
+		frame[n / 2] = 0;
+		check(proto_decode(frame + 1, n - 2, decoded) == -1, "zero in frame accepted", len);
+	}
+	
+	// All 0x01 decodes to a zero per byte but the last, so the longest
+	// of these would fill more than proto_decode()'s buffer
+	uint8_t ones[PROTO_FRAME_MAX];
+	memset(ones, 0x01, sizeof(ones));
+	
+	for(size_t len = PROTO_RECORD_MAX; len <= sizeof(ones); len++)
+		check(proto_decode(ones, len, decoded) == -1, "over-long frame of 0x01 accepted", len);
+	
+	// Up to, and past, the destination's end
+	for(size_t cap = 0; cap <= PROTO_RECORD_MAX + 4; cap++) {
+		bool guard_ok;
+		
+		int n = decode_guarded(ones, cap + 1, cap, guard_ok);
+		check(n == (int) cap && guard_ok, "0x01 frame that fits", cap + 1);
+		
+		n = decode_guarded(ones, cap + 2, cap, guard_ok);
+		check(n == -1 && guard_ok, "0x01 frame past the destination", cap + 2);
+	}
+	
+	printf("%d checks, %d failed\n", checks, failures);
+	
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,123 @@
+/**
+ * Display transfer check.
+ *
+ * Runs typical redraws of display.cpp on the emulated controller of
+ * ssd1306_host.cpp, and checks the bytes each one puts on the wire
+ * (I2C: address, control bytes, commands and data) against a budget,
+ * see ssd1306_UpdateScreen(). After each, the panel has to match the
+ * screenbuffer, so trimming an update never loses a change.
+ *
+ * Usage: check_redraw [-v]
+ *   -v  print every redraw, also the passing ones
+ *
+ * Exits with 1 if a redraw is over its budget, or the panel differs.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../chronograph.h"
+#include "../display.h"
+#include "ssd1306_host.h"
+
+// Budgets (bytes), the whole screen in page addressing mode:
+// per page, address, 3 commands and their control bytes, and data
+#define FULL_SCREEN (SSD1306_PAGES * (1 + 6 + 1 + SSD1306_WIDTH))
+
+// -------------------------------------------------
+
+// Shown on the diagnostics page
+chrono_counters_t counters;
+
+static bool verbose;
+static int failures;
+
+static ssd1306_host_stats_t prev;
+
+// Bytes since the previous check, at most max
+static void check(const char *what, uint32_t max) {
+	uint8_t panel[SSD1306_PAGES * SSD1306_WIDTH];
+	uint32_t bytes = ssd1306_host_stats.bytes - prev.bytes;
+	bool ok = (bytes <= max);
+	
+	prev = ssd1306_host_stats;
+	ssd1306_host_panel(panel);
+	
+	if(memcmp(panel, ssd1306_GetBuffer(), sizeof(panel)) != 0) {
+		printf("FAIL %-28s panel differs from the screenbuffer\n", what);
+		failures++;
+	}
+	
+	if(!ok)
+		failures++;
+	
+	if(!ok || verbose)
+		printf("%s %-28s %5u bytes, budget %5u\n", ok ? "ok  " : "FAIL", what, bytes, max);
+}
+
+int main(int argc, char *argv[]) {
+	chrono_stat_t stat = {.mode = mode_fps, .weight = WEIGHT};
+	int opt;
+	
+	while((opt = getopt(argc, argv, "v")) != -1) {
+		switch(opt) {
+			case 'v': verbose = true; break;
+			
+			default:
+				fprintf(stderr, "Usage: %s [-v]\n", argv[0]);
+				return 2;
+		}
+	}
+	
+	display_init();
+	prev = ssd1306_host_stats;
+	
+	// After display_init() cleared the screen
+	display_draw(stat);
+	check("stat, first draw", 500);
+	
+	display_draw(stat);
+	check("stat, unchanged", 0);
+	
+	chrono_stat_update(stat, 300);
+	display_draw(stat);
+	check("stat, first shot", 450);
+	
+	chrono_stat_update(stat, 301);
+	display_draw(stat);
+	check("stat, one digit", 160);
+	
+	for(int i = 0; i < 20; i++) {
+		chrono_stat_update(stat, 290 + (i * 7) % 20);
+		display_draw(stat);
+	}
+	
+	prev = ssd1306_host_stats;
+	
+	chrono_stat_update(stat, 305);
+	display_draw(stat);
+	check("stat, shot in a series", 220);
+	
+	display_next_page();
+	display_draw(stat);
+	check("histogram, page change", FULL_SCREEN);
+	
+	chrono_stat_update(stat, 302);
+	display_draw(stat);
+	check("histogram, shot", 100);
+	
+	display_draw(stat);
+	check("histogram, unchanged", 0);
+	
+	display_next_page();
+	display_draw(stat);
+	check("diag, page change", FULL_SCREEN);
+	
+	counters.shots++;
+	display_draw(stat);
+	check("diag, one counter", 40);
+	
+	printf("%s\n", failures ? "FAILED" : "passed");
+	return failures ? 1 : 0;
+}
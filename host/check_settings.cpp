@@ -0,0 +1,116 @@
+/**
+ * Settings check.
+ *
+ * The defaults have to pass settings_validate() (settings.cpp), and
+ * each field just outside of its range has to fail it, through
+ * `set` (command.cpp) as well. A stored page that is out of range
+ * is not loaded, even with a valid CRC, and a valid one survives
+ * settings_save() and settings_load(), on the host's flash page.
+ *
+ * Usage: check_settings
+ *
+ * Exits with 1 on any failure, printing it.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../hal.h"
+#include "../chronograph.h"
+#include "../settings.h"
+#include "../command.h"
+
+// -------------------------------------------------
+
+// Shown by `counters`
+chrono_counters_t counters;
+
+static int checks, failures;
+
+static void check(bool ok, const char *what) {
+	checks++;
+	
+	if(!ok) {
+		printf("FAIL %s\n", what);
+		failures++;
+	}
+}
+
+static char reply[CMD_LINE_MAX];
+
+static void output(const char *str) {
+	strncat(reply, str, sizeof(reply) - strlen(reply) - 1);
+}
+
+// A command's reply
+static const char *exec(const char *command) {
+	char line[CMD_LINE_MAX];
+	
+	snprintf(line, sizeof(line), "%s", command);
+	reply[0] = '\0';
+	cmd_exec(line, output);
+	
+	return reply;
+}
+
+// The defaults, with one field changed, pass settings_validate() or not
+#define CHECK_FIELD(field, value, valid) do { \
+	chrono_settings_t s; \
+	settings_defaults(s); \
+	s.field = value; \
+	check(settings_validate(s) == valid, valid ? \
+		#field " " #value " rejected" : #field " " #value " accepted"); \
+} while(0)
+
+int main() {
+	chrono_settings_t s;
+	
+	settings_defaults(s);
+	check(settings_validate(s), "defaults invalid");
+	
+	CHECK_FIELD(peak_lag, 0, false);
+	CHECK_FIELD(peak_lag, PEAK_LAG_MAX, true);
+	CHECK_FIELD(peak_lag, PEAK_LAG_MAX + 1, false);
+	CHECK_FIELD(peak_threshold, 0, false);
+	CHECK_FIELD(peak_threshold, 4096, false);
+	CHECK_FIELD(peak_influence, 2, false);
+	CHECK_FIELD(adc_prescaler, 3, false);
+	CHECK_FIELD(adc_prescaler, 10, false);
+	CHECK_FIELD(mode, mode_rps + 1, false);
+	CHECK_FIELD(output, output_binary + 1, false);
+	CHECK_FIELD(log, log_text + 1, false);
+	CHECK_FIELD(calibration, 0, false);
+	CHECK_FIELD(distance_um, 0, false);
+	
+	CHECK_FIELD(weight, 0, false);
+	CHECK_FIELD(weight, 1, true);
+	CHECK_FIELD(weight, SETTINGS_MAX_WEIGHT, true);
+	CHECK_FIELD(weight, SETTINGS_MAX_WEIGHT + 1, false);
+	CHECK_FIELD(weight, 65535, false);
+	
+	// `set` keeps the settings valid
+	settings_defaults(settings);
+	
+	check(strcmp(exec("set weight -5"), "ERR bad value\n") == 0, "set weight -5 accepted");
+	check(strcmp(exec("set weight 0"), "ERR out of range\n") == 0, "set weight 0 accepted");
+	check(strcmp(exec("set weight 100"), "ERR out of range\n") == 0, "set weight 100 accepted");
+	check(settings.weight == WEIGHT, "weight changed by a failed set");
+	check(strcmp(exec("set weight 28"), "weight=28\n") == 0, "set weight 28 failed");
+	
+	// Saved and loaded
+	check(settings_save(), "save failed");
+	settings_defaults(settings);
+	check(settings_load() && settings.weight == 28, "saved settings not loaded");
+	
+	// Out of range, with a valid CRC
+	settings_defaults(s);
+	s.weight = 0;
+	s.crc = settings_crc(s);
+	hal_flash_write(&s, sizeof(s));
+	
+	check(!settings_load() && settings.weight == WEIGHT, "out of range page loaded");
+	
+	printf("%d checks, %d failed\n", checks, failures);
+	
+	return failures ? 1 : 0;
+}
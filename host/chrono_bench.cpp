@@ -0,0 +1,392 @@
+/**
+ * Detection accuracy and throughput benchmark.
+ *
+ * Runs the firmware's measurement loop (see host/chrono_sim.cpp) on
+ * synthetic shots (see host/waveform.h), over a grid of speeds, BB
+ * diameters, signal-to-noise ratios, ambient drift and ADC sample
+ * times. Each run is a forked process, running the unchanged
+ * chrono() in binary output mode. Its shot records are matched
+ * against the generated shots.
+ *
+ * For every run, a JSON object is written: the speed error
+ * distribution (%), missed and extra shots, timeouts, and the host
+ * time per simulated sample. Only the measurement loop is timed: the
+ * waveform is generated beforehand, for every conversion, and looked
+ * up during the run. Sample times that settings_validate() rejects
+ * are listed, but not run.
+ *
+ * Usage: chrono_bench [-q] [-n shots]
+ *   -q  quick: a reduced grid
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include <vector>
+#include <algorithm>
+
+#include "../hal.h"
+#include "../settings.h"
+#include "../protocol.h"
+#include "waveform.h"
+
+// -------------------------------------------------
+
+typedef struct {
+	const char *name;
+	uint8_t sample_time;
+	uint8_t prescaler;
+} sample_config_t;
+
+static const sample_config_t sample_configs[] = {
+	{"7.5/2", ADC_SMPR_SMP_7DOT5CYC, 2},
+	{"28.5/2", ADC_SMPR_SMP_28DOT5CYC, 2},
+	{"71.5/2", ADC_SMPR_SMP_71DOT5CYC, 2},
+	{"71.5/4", ADC_SMPR_SMP_71DOT5CYC, 4},
+	{"239.5/2", ADC_SMPR_SMP_239DOT5CYC, 2},
+};
+
+static const double speeds[] = {30, 60, 100, 150, 200, 250};
+static const double diameters[] = {4.5, 6};
+static const double snrs[] = {5, 10, 20, 50};
+static const double drifts[] = {0, 100};
+
+#define COUNT(a) (sizeof(a) / sizeof(*a))
+
+// Pulse amplitude at full cover (ADC counts)
+#define AMPLITUDE 400
+
+typedef struct {
+	const sample_config_t *sample;
+	wave_t wave;
+} scenario_t;
+
+// Sent by the child, at the end of a run
+typedef struct {
+	uint64_t conversions;
+	uint64_t wall_ns;
+	uint32_t timeouts;
+} run_stats_t;
+
+// -------------------------------------------------
+
+static wave_t child_wave;
+static int child_stats_fd;
+static uint64_t child_start_ns;
+
+// The waveform at each conversion, front and rear, see pregenerate()
+static std::vector<uint16_t> child_samples;
+static uint64_t child_period_ns, child_convert_ns;
+
+static uint64_t wall_ns() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	
+	return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static uint16_t child_source(uint8_t channel, uint64_t time_ns) {
+	uint8_t ch = (channel == CHANNEL_FRONT ? 0 : 1);
+	uint64_t t = time_ns - child_convert_ns;
+	
+	if(time_ns >= child_convert_ns && t % child_period_ns == 0
+			&& t / child_period_ns < child_samples.size() / 2)
+		return child_samples[t / child_period_ns * 2 + ch];
+	
+	// Off the grid, not expected
+	return wave_sample(child_wave, ch, time_ns);
+}
+
+/* The clock only advances by adc_read()s, one sample period each,
+ * from 0. So conversion k samples at k periods plus the conversion
+ * time, see host/hal_host.h. */
+static void pregenerate(const wave_t &w) {
+	child_period_ns = settings_sample_period_ns(settings);
+	child_convert_ns = settings_conversion_ps(settings) / 1000;
+	
+	uint64_t count = wave_end_ns(w) / child_period_ns + 2;
+	child_samples.resize(count * 2);
+	
+	for(uint64_t k = 0; k < count; k++) {
+		uint64_t time_ns = k * child_period_ns + child_convert_ns;
+		
+		child_samples[k * 2] = wave_sample(w, 0, time_ns);
+		child_samples[k * 2 + 1] = wave_sample(w, 1, time_ns);
+	}
+}
+
+static void child_end() {
+	run_stats_t stats = {
+		.conversions = hal_sim.conversions,
+		.wall_ns = wall_ns() - child_start_ns,
+		.timeouts = counters.timeouts
+	};
+	
+	fflush(stdout);
+	
+	if(write(child_stats_fd, &stats, sizeof(stats)) != sizeof(stats))
+		_exit(1);
+	
+	_exit(0);
+}
+
+// In the child. The VCP (stdout) goes to out_fd.
+static void run_child(const scenario_t &sc, int out_fd, int stats_fd) {
+	int null_fd = open("/dev/null", O_RDONLY);
+	
+	dup2(null_fd, 0);
+	dup2(out_fd, 1);
+	
+	child_wave = sc.wave;
+	child_stats_fd = stats_fd;
+	
+	hal_sim.source = child_source;
+	hal_sim.end = child_end;
+	hal_sim.end_ns = wave_end_ns(sc.wave);
+	
+	pregenerate(sc.wave);
+	child_start_ns = wall_ns();
+	
+	hal_init();
+	chrono_main();
+}
+
+// -------------------------------------------------
+
+typedef struct {
+	bool ran;
+	run_stats_t stats;
+	
+	uint32_t detected;
+	uint32_t extra;
+	
+	// Speed errors (%) of the detected shots
+	std::vector<double> errors;
+} result_t;
+
+static void match_shot(const scenario_t &sc, const proto_shot_t &shot,
+		std::vector<bool> &seen, result_t &res) {
+	
+	const wave_t &w = sc.wave;
+	
+	double rear_ms = shot.time_ms - wave_flight_ns(w) * 1e-6;
+	long k = lround(rear_ms / w.interval_ms);
+	
+	if(k < 1 || k > (long) w.shots || seen[k]) {
+		res.extra++;
+		return;
+	}
+	
+	seen[k] = true;
+	res.detected++;
+	res.errors.push_back((shot.speed - w.speed_mps) / w.speed_mps * 100);
+}
+
+static void decode(const scenario_t &sc, const uint8_t *data, size_t len, result_t &res) {
+	std::vector<bool> seen(sc.wave.shots + 1);
+	uint8_t record[PROTO_RECORD_MAX];
+	size_t start = 0;
+	
+	for(size_t i = 0; i < len; i++) {
+		if(data[i] != 0)
+			continue;
+		
+		int n = (i > start ? proto_decode(data + start, i - start, record) : -1);
+		start = i + 1;
+		
+		if(n == sizeof(proto_shot_t) && record[0] == PROTO_SHOT) {
+			proto_shot_t shot;
+			memcpy(&shot, record, sizeof(shot));
+			
+			match_shot(sc, shot, seen, res);
+		}
+	}
+}
+
+static bool run(const scenario_t &sc, result_t &res) {
+	int out_pipe[2], stats_pipe[2];
+	
+	fflush(stdout);
+	
+	if(pipe(out_pipe) != 0 || pipe(stats_pipe) != 0)
+		return false;
+	
+	pid_t pid = fork();
+	
+	if(pid < 0)
+		return false;
+	
+	if(pid == 0) {
+		close(out_pipe[0]);
+		close(stats_pipe[0]);
+		
+		run_child(sc, out_pipe[1], stats_pipe[1]);
+		_exit(1);
+	}
+	
+	close(out_pipe[1]);
+	close(stats_pipe[1]);
+	
+	std::vector<uint8_t> output;
+	uint8_t buf[4096];
+	ssize_t n;
+	
+	while((n = read(out_pipe[0], buf, sizeof(buf))) > 0)
+		output.insert(output.end(), buf, buf + n);
+	
+	bool ok = (read(stats_pipe[0], &res.stats, sizeof(res.stats)) == sizeof(res.stats));
+	
+	close(out_pipe[0]);
+	close(stats_pipe[0]);
+	
+	int status;
+	waitpid(pid, &status, 0);
+	
+	if(!ok || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+		return false;
+	
+	res.ran = true;
+	decode(sc, output.data(), output.size(), res);
+	
+	return true;
+}
+
+// -------------------------------------------------
+
+static double percentile(std::vector<double> sorted, double p) {
+	if(sorted.empty())
+		return 0;
+	
+	size_t i = (size_t) (p * (sorted.size() - 1) + 0.5);
+	return sorted[i];
+}
+
+static void print_result(const scenario_t &sc, const result_t &res, bool first) {
+	const wave_t &w = sc.wave;
+	
+	printf("%s\n    {\"speed_mps\": %g, \"diameter_mm\": %g, \"snr\": %g, "
+		"\"drift\": %g, \"sample\": \"%s\", \"sample_ns\": %u, \"valid\": %s",
+		first ? "" : ",", w.speed_mps, w.diameter_mm, w.amplitude / w.noise_rms,
+		w.drift, sc.sample->name, settings_sample_period_ns(settings),
+		res.ran ? "true" : "false");
+	
+	if(!res.ran) {
+		printf("}");
+		return;
+	}
+	
+	double mean = 0, var = 0;
+	std::vector<double> abs_errors;
+	
+	for(double e : res.errors) {
+		mean += e;
+		abs_errors.push_back(fabs(e));
+	}
+	
+	if(!res.errors.empty())
+		mean /= res.errors.size();
+	
+	for(double e : res.errors)
+		var += (e - mean) * (e - mean);
+	
+	if(res.errors.size() > 1)
+		var /= res.errors.size() - 1;
+	
+	std::sort(abs_errors.begin(), abs_errors.end());
+	
+	printf(",\n     \"shots\": %u, \"detected\": %u, \"missed\": %u, \"extra\": %u, "
+		"\"timeouts\": %u, \"miss_rate\": %.4f,\n"
+		"     \"error_pct\": {\"mean\": %.4f, \"std\": %.4f, \"abs_p50\": %.4f, "
+		"\"abs_p95\": %.4f, \"abs_max\": %.4f},\n"
+		"     \"samples\": %llu, \"ns_per_sample\": %.2f}",
+		w.shots, res.detected, w.shots - res.detected, res.extra,
+		res.stats.timeouts, 1 - (double) res.detected / w.shots,
+		mean, sqrt(var), percentile(abs_errors, 0.5), percentile(abs_errors, 0.95),
+		abs_errors.empty() ? 0 : abs_errors.back(),
+		(unsigned long long) res.stats.conversions,
+		(double) res.stats.wall_ns / res.stats.conversions);
+}
+
+int main(int argc, char *argv[]) {
+	bool quick = false;
+	uint32_t shots = 20;
+	int opt;
+	
+	while((opt = getopt(argc, argv, "qn:")) != -1) {
+		switch(opt) {
+			case 'q': quick = true; break;
+			case 'n': shots = atoi(optarg); break;
+			
+			default:
+				fprintf(stderr, "Usage: %s [-q] [-n shots]\n", argv[0]);
+				return 2;
+		}
+	}
+	
+	printf("{\"benchmark\": \"chrono\", \"ns_per_sample\": \"host time of chrono() per "
+		"conversion, on the simulated HAL, with the waveform pre-generated\", \"runs\": [");
+	
+	bool first = true;
+	uint32_t runs = 0, failed = 0;
+	
+	for(const sample_config_t &sample : sample_configs)
+	for(double speed : speeds)
+	for(double diameter : diameters)
+	for(double snr : snrs)
+	for(double drift : drifts) {
+		if(quick && (diameter != 6 || snr != 20 || drift != 0
+				|| (speed != 60 && speed != 250)))
+			continue;
+		
+		settings_defaults(settings);
+		
+		settings.output = output_binary;
+		settings.adc_sample_time = sample.sample_time;
+		settings.adc_prescaler = sample.prescaler;
+		
+		scenario_t sc = {
+			.sample = &sample,
+			.wave = {
+				.speed_mps = speed,
+				.diameter_mm = diameter,
+				.aperture_mm = 3,
+				.distance_um = settings.distance_um,
+				
+				.baseline = 2000,
+				.amplitude = AMPLITUDE,
+				.noise_rms = AMPLITUDE / snr,
+				
+				.drift = drift,
+				.drift_period_s = 0.5,
+				
+				.shots = shots,
+				.interval_ms = 50,
+				.seed = runs
+			}
+		};
+		
+		result_t res = {};
+		
+		// Loaded by chrono_main(), in the child
+		if(settings_save() && !run(sc, res))
+			failed++;
+		
+		print_result(sc, res, first);
+		
+		first = false;
+		runs++;
+	}
+	
+	printf("\n]}\n");
+	
+	if(failed)
+		fprintf(stderr, "%u of %u runs failed\n", failed, runs);
+	
+	return (failed ? 1 : 0);
+}
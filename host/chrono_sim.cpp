@@ -0,0 +1,354 @@
+/**
+ * Chronograph simulator.
+ *
+ * Runs the firmware's state machine, chrono(), against the host HAL
+ * (see host/hal_host.h), on a virtual clock. The photodiodes see a
+ * series of shots at a fixed speed, see host/waveform.h. The VCP
+ * is stdin/stdout, so the output is what the
+ * firmware would send, in the configured mode, and commands can be
+ * piped in.
+ *
+ * With -r, a recorded trace (see trace.h, host/streamrec.cpp) is
+ * replayed instead, until its end: each conversion sees the latest
+ * sample of its channel, as the ADC would have. Gaps hold the last
+ * recorded value. The run only depends on the trace and the settings,
+ * so with -b (binary output, piped into shotdec) the shot lists of
+ * two detector versions can be diffed. The trace is memory-mapped
+ * and decoded a chunk at a time, so any size starts at once. With
+ * -x, the detected shots are written to the trace's shot index.
+ *
+ * -s name=value changes a setting, as the `set` command, before
+ * booting. A trace's gate distance is used, unless set. At the end,
+ * the counters (and the expected speed) are printed on stderr, and
+ * the display can be saved as a PBM image. Built with PROFILE, the
+ * total time of each profiled stage follows, see profile.h.
+ *
+ * Usage: chrono_sim [-v m/s] [-n shots] [-i interval_ms] [-d diameter_mm]
+ *                   [-a amplitude] [-z noise_rms] [-e drift] [-r trace]
+ *                   [-x] [-s name=value]... [-b] [-p out.pbm]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "../hal.h"
+#include "../settings.h"
+#include "../display.h"
+#include "../command.h"
+#include "../protocol.h"
+#include "../profile.h"
+#include "ssd1306_host.h"
+#include "trace_file.h"
+#include "waveform.h"
+
+// -------------------------------------------------
+
+typedef struct {
+	wave_t wave;
+	
+	const char *pbm_path;
+	
+	// Replayed, if trace.data
+	const char *trace_path;
+	trace_file_t trace;
+	double pairs_per_ns;
+	
+	// Write the detected shots to the trace's index
+	bool index_shots;
+} sim_config_t;
+
+static sim_config_t config = {
+	.wave = {
+		.speed_mps = 100,
+		.diameter_mm = 6,
+		.aperture_mm = 3,
+		.distance_um = 0,
+		
+		.baseline = 2000,
+		.amplitude = 400,
+		.noise_rms = 3,
+		
+		.drift = 0,
+		.drift_period_s = 2,
+		
+		.shots = 10,
+		.interval_ms = 200,
+		.seed = 1
+	},
+	
+	.pbm_path = NULL,
+	
+	.trace_path = NULL,
+	.trace = {},
+	.pairs_per_ns = 0,
+	
+	.index_shots = false
+};
+
+// The replayed chunk, with the gaps filled
+static struct {
+	uint64_t chunk;
+	uint32_t pairs;
+	
+	// Last value of each channel, so far
+	uint16_t hold[STREAM_CHANNELS];
+	
+	uint16_t samples[TRACE_CHUNK_SAMPLES];
+} replay = {.chunk = UINT64_MAX};
+
+static std::vector<trace_shot_t> shots;
+
+// -------------------------------------------------
+
+static uint16_t source(uint8_t channel, uint64_t time_ns) {
+	return wave_sample(config.wave, channel == CHANNEL_FRONT ? 0 : 1, time_ns);
+}
+
+/* Chunks are replayed in order, so the values held over gaps
+ * carry over from the previous one. A corrupt chunk is a gap. */
+static void replay_load(uint64_t k) {
+	if(k != replay.chunk + 1) {
+		for(int ch = 0; ch < STREAM_CHANNELS; ch++)
+			replay.hold[ch] = config.wave.baseline;
+	}
+	
+	replay.chunk = k;
+	replay.pairs = trace_read_chunk(config.trace, k, replay.samples);
+	
+	for(uint32_t i = 0; i < replay.pairs * STREAM_CHANNELS; i++) {
+		uint16_t &value = replay.samples[i];
+		
+		if(value == TRACE_GAP)
+			value = replay.hold[i % STREAM_CHANNELS];
+		else
+			replay.hold[i % STREAM_CHANNELS] = value;
+	}
+}
+
+// The latest sample of the channel, at the trace's rate
+static uint16_t replay_source(uint8_t channel, uint64_t time_ns) {
+	uint64_t pair = time_ns * config.pairs_per_ns;
+	int ch = (channel == CHANNEL_FRONT ? 0 : 1);
+	
+	if(pair >= config.trace.num_pairs)
+		pair = config.trace.num_pairs - 1;
+	
+	if(pair / TRACE_CHUNK_PAIRS != replay.chunk)
+		replay_load(pair / TRACE_CHUNK_PAIRS);
+	
+	uint32_t i = pair % TRACE_CHUNK_PAIRS;
+	
+	if(i >= replay.pairs)
+		return replay.hold[ch];
+	
+	return replay.samples[i * STREAM_CHANNELS + ch];
+}
+
+// Shot records, located in the trace by the time they're sent
+static void index_shot(const proto_shot_t &shot) {
+	double period_ns = config.trace.header->period_ps * 1e-3;
+	double dt_ns = (double) shot.ticks * 1e9 / shot.timer_freq;
+	
+	uint64_t rear = hal_sim.now_ns / period_ns;
+	uint64_t flight = dt_ns / period_ns + 0.5;
+	
+	shots.push_back((trace_shot_t) {
+		.front_pair = (rear > flight ? rear - flight : 0),
+		.rear_pair = rear,
+		.ticks = shot.ticks,
+		.timer_freq = shot.timer_freq,
+		.speed = shot.speed
+	});
+}
+
+// Also passed on to stdout
+static void index_output(const uint8_t *data, size_t len) {
+	static uint8_t frame[PROTO_FRAME_MAX];
+	static size_t frame_len;
+	
+	fwrite(data, 1, len, stdout);
+	
+	for(size_t i = 0; i < len; i++) {
+		if(data[i] != 0) {
+			if(frame_len < sizeof(frame))
+				frame[frame_len++] = data[i];
+			
+			continue;
+		}
+		
+		uint8_t record[PROTO_RECORD_MAX];
+		int n = (frame_len ? proto_decode(frame, frame_len, record) : -1);
+		
+		frame_len = 0;
+		
+		if(n == sizeof(proto_shot_t) && record[0] == PROTO_SHOT) {
+			proto_shot_t shot;
+			memcpy(&shot, record, sizeof(shot));
+			
+			index_shot(shot);
+		}
+	}
+}
+
+static bool set_failed, distance_set;
+
+static void set_output(const char *str) {
+	fputs(str, stderr);
+	
+	if(strncmp(str, "ERR", 3) == 0)
+		set_failed = true;
+}
+
+// Like the `set` command
+static void set_param(const char *assignment) {
+	char line[CMD_LINE_MAX];
+	const char *eq = strchr(assignment, '=');
+	
+	if(!eq || snprintf(line, sizeof(line), "set %.*s %s",
+			(int) (eq - assignment), assignment, eq + 1) >= (int) sizeof(line)) {
+		fprintf(stderr, "bad setting: %s\n", assignment);
+		exit(2);
+	}
+	
+	distance_set |= (strncmp(assignment, "distance=", 9) == 0);
+	cmd_exec(line, set_output);
+	
+	if(set_failed)
+		exit(2);
+}
+
+static void end() {
+	fflush(stdout);
+	
+	fprintf(stderr, "%.3f s simulated (%llu samples): %u shots, %u timeouts",
+		hal_sim.now_ns * 1e-9, (unsigned long long) hal_sim.conversions,
+		counters.shots, counters.timeouts);
+	
+	if(config.trace.data)
+		fprintf(stderr, "\n");
+	else {
+		fprintf(stderr, " (%u shots at %.2f m/s expected)\n",
+			config.wave.shots, config.wave.speed_mps);
+	}
+	
+	// Time per stage, when built with PROFILE, see chrono_tune
+	#if defined(PROFILE)
+		#define PROF_TOTAL(id, name) fprintf(stderr, "prof %s %llu " PROF_UNIT "\n", \
+			name, (unsigned long long) prof_hists[id].sum);
+		PROF_STAGES(PROF_TOTAL)
+		#undef PROF_TOTAL
+	#endif
+	
+	if(config.pbm_path) {
+		uint8_t pages[SSD1306_PAGES * SSD1306_WIDTH];
+		
+		ssd1306_host_panel(pages);
+		
+		if(!ssd1306_host_write_pbm(config.pbm_path, pages)) {
+			perror(config.pbm_path);
+			exit(1);
+		}
+	}
+	
+	if(config.index_shots) {
+		trace_close(config.trace);
+		
+		if(!trace_write_shots(config.trace_path, shots.data(), shots.size()))
+			exit(1);
+		
+		fprintf(stderr, "%zu shot(s) indexed\n", shots.size());
+	}
+	
+	exit(0);
+}
+
+static int usage(const char *name) {
+	fprintf(stderr, "Usage: %s [-v m/s] [-n shots] [-i interval_ms] "
+		"[-d diameter_mm] [-a amplitude] [-z noise_rms] [-e drift] "
+		"[-r trace] [-x] [-s name=value]... [-b] [-p out.pbm]\n", name);
+	return 2;
+}
+
+int main(int argc, char *argv[]) {
+	int opt;
+	
+	settings_defaults(settings);
+	
+	wave_t &wave = config.wave;
+	
+	while((opt = getopt(argc, argv, "v:n:i:d:a:z:e:r:xs:bp:")) != -1) {
+		switch(opt) {
+			case 'v': wave.speed_mps = atof(optarg); break;
+			case 'n': wave.shots = atoi(optarg); break;
+			case 'i': wave.interval_ms = atoi(optarg); break;
+			case 'd': wave.diameter_mm = atof(optarg); break;
+			case 'a': wave.amplitude = atof(optarg); break;
+			case 'z': wave.noise_rms = atof(optarg); break;
+			case 'e': wave.drift = atof(optarg); break;
+			case 'p': config.pbm_path = optarg; break;
+			case 's': set_param(optarg); break;
+			case 'b': settings.output = output_binary; break;
+			case 'x': config.index_shots = true; break;
+			
+			case 'r':
+				if(!trace_open(config.trace, optarg))
+					return 1;
+				
+				config.trace_path = optarg;
+				break;
+			
+			default: return usage(argv[0]);
+		}
+	}
+	
+	if(wave.speed_mps <= 0 || wave.interval_ms == 0)
+		return usage(argv[0]);
+	
+	if(config.index_shots) {
+		if(!config.trace.data || !config.trace.header->index_offset) {
+			fprintf(stderr, "-x needs a complete trace (-r)\n");
+			return 2;
+		}
+		
+		// The shots are taken from the binary records
+		settings.output = output_binary;
+		hal_sim.output = index_output;
+	}
+	
+	if(config.trace.data) {
+		if(config.trace.num_pairs == 0) {
+			fprintf(stderr, "%s: empty trace\n", config.trace_path);
+			return 1;
+		}
+		
+		if(config.trace.header->distance_um && !distance_set)
+			settings.distance_um = config.trace.header->distance_um;
+	}
+	
+	// Loaded by chrono_main()
+	if(!settings_save()) {
+		fprintf(stderr, "invalid settings\n");
+		return 2;
+	}
+	
+	hal_sim.end = end;
+	
+	if(config.trace.data) {
+		config.pairs_per_ns = 1000.0 / config.trace.header->period_ps;
+		
+		hal_sim.source = replay_source;
+		hal_sim.end_ns = config.trace.num_pairs * config.trace.header->period_ps / 1000;
+	} else {
+		wave.distance_um = settings.distance_um;
+		
+		hal_sim.source = source;
+		hal_sim.end_ns = wave_end_ns(wave);
+	}
+	
+	hal_init();
+	chrono_main();
+}
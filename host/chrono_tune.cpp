@@ -0,0 +1,573 @@
+/**
+ * Detector parameter tuner.
+ *
+ * Searches the peak detection settings (lag, threshold, influence)
+ * over a corpus of labeled traces: traces (see trace.h) whose shot
+ * index holds the true shots, e.g. from chrono_sim -x with trusted
+ * settings, checked with tracecat. Each parameter set is replayed
+ * over every trace by chrono_sim_prof (chrono_sim, built with
+ * PROFILE, -r, -b), found next to this tool, and its shots are
+ * matched to the labels by their rear trigger time.
+ *
+ * Every (parameter set, trace) run is a job. Jobs are dealt out to
+ * one worker thread per core, each with its own queue, and workers
+ * that run out steal from the others' queues, so that slow traces
+ * don't leave cores idle at the end.
+ *
+ * For each parameter set:
+ *   miss rate    labels without a matching shot
+ *   false rate   shots without a matching label, and timeouts (front
+ *                triggers without a rear one), per minute of trace
+ *   cost         measured ns per sample of the detection stages
+ *                (peak, calc and report, see profile.h), summed
+ *                over the replays. It's host time, so it varies
+ *                between runs, and more with -j at the core count.
+ *
+ * The Pareto front of the three is printed, as CSV, best miss rate
+ * first. With -o, every parameter set is written, in the same form.
+ *
+ * Usage: chrono_tune [-l lags] [-t thresholds] [-i influences]
+ *                    [-r count] [-j threads] [-o all.csv] trace...
+ *
+ * Lists are comma-separated values, or first:last[:step] ranges,
+ * e.g. -l 10:120:10 -t 20,40,80. The default is a grid, with -r a
+ * random sample of count sets from the same lists.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <poll.h>
+#include <sys/wait.h>
+
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <random>
+#include <algorithm>
+
+#include "../protocol.h"
+#include "../chronograph.h"
+#include "trace_file.h"
+
+extern char **environ;
+
+// -------------------------------------------------
+
+// Largest difference between a shot's and its label's rear trigger
+#define MATCH_TOLERANCE_MS 2
+
+// Profiled stages in the cost, see chrono_sim's summary
+static const char *const cost_stages[] = {"peak", "calc", "report"};
+
+typedef struct {
+	uint16_t lag;
+	uint16_t threshold;
+	uint16_t influence;
+} params_t;
+
+typedef struct {
+	const char *path;
+	double duration_s;
+	
+	// Rear trigger times of the labels (ms)
+	std::vector<double> labels;
+} corpus_trace_t;
+
+typedef struct {
+	params_t params;
+	
+	// Summed over the traces, under lock
+	std::mutex lock;
+	bool invalid;
+	
+	uint32_t labels, missed;
+	uint32_t extra, timeouts;
+	double duration_s;
+	
+	// Detection stages (ns)
+	uint64_t cost_ns;
+	uint64_t samples;
+} result_t;
+
+typedef struct {
+	uint32_t set;
+	uint32_t trace;
+} job_t;
+
+typedef struct {
+	std::mutex lock;
+	std::deque<job_t> jobs;
+} worker_queue_t;
+
+static char sim_path[PATH_MAX];
+
+static std::vector<corpus_trace_t> corpus;
+static std::vector<result_t> results;
+static std::vector<worker_queue_t> queues;
+
+// -------------------------------------------------
+
+// Shots, from chrono_sim's binary output
+static void decode_shots(const std::vector<uint8_t> &data, std::vector<proto_shot_t> &shots) {
+	uint8_t record[PROTO_RECORD_MAX];
+	size_t start = 0;
+	
+	for(size_t i = 0; i < data.size(); i++) {
+		if(data[i] != 0)
+			continue;
+		
+		int n = -1;
+		
+		if(i > start && i - start <= PROTO_FRAME_MAX)
+			n = proto_decode(&data[start], i - start, record);
+		
+		start = i + 1;
+		
+		if(n == sizeof(proto_shot_t) && record[0] == PROTO_SHOT) {
+			proto_shot_t shot;
+			memcpy(&shot, record, sizeof(shot));
+			
+			shots.push_back(shot);
+		}
+	}
+}
+
+// Both pipes to their end, so that neither fills up and blocks the child
+static void read_all(int out_fd, int err_fd, std::vector<uint8_t> &out, std::vector<uint8_t> &err) {
+	struct pollfd fds[2] = {{.fd = out_fd, .events = POLLIN}, {.fd = err_fd, .events = POLLIN}};
+	std::vector<uint8_t> *data[2] = {&out, &err};
+	uint8_t buf[4096];
+	
+	while(fds[0].fd >= 0 || fds[1].fd >= 0) {
+		if(poll(fds, 2, -1) < 0) {
+			perror("poll");
+			exit(1);
+		}
+		
+		for(int i = 0; i < 2; i++) {
+			if(fds[i].fd < 0 || !fds[i].revents)
+				continue;
+			
+			ssize_t n = read(fds[i].fd, buf, sizeof(buf));
+			
+			if(n > 0)
+				data[i]->insert(data[i]->end(), buf, buf + n);
+			else {
+				close(fds[i].fd);
+				fds[i].fd = -1;
+			}
+		}
+	}
+}
+
+static void run_job(const job_t &job) {
+	result_t &res = results[job.set];
+	const corpus_trace_t &trace = corpus[job.trace];
+	
+	char lag[32], threshold[32], influence[32];
+	
+	snprintf(lag, sizeof(lag), "lag=%u", res.params.lag);
+	snprintf(threshold, sizeof(threshold), "threshold=%u", res.params.threshold);
+	snprintf(influence, sizeof(influence), "influence=%u", res.params.influence);
+	
+	char *argv[] = {
+		sim_path, (char *) "-b", (char *) "-r", (char *) trace.path,
+		(char *) "-s", lag, (char *) "-s", threshold, (char *) "-s", influence,
+		NULL
+	};
+	
+	int out[2], err[2];
+	posix_spawn_file_actions_t actions;
+	pid_t pid;
+	
+	// Not inherited by the other workers' children
+	if(pipe2(out, O_CLOEXEC) != 0 || pipe2(err, O_CLOEXEC) != 0) {
+		perror("pipe");
+		exit(1);
+	}
+	
+	posix_spawn_file_actions_init(&actions);
+	posix_spawn_file_actions_addopen(&actions, 0, "/dev/null", O_RDONLY, 0);
+	posix_spawn_file_actions_adddup2(&actions, out[1], 1);
+	posix_spawn_file_actions_adddup2(&actions, err[1], 2);
+	
+	if(posix_spawn(&pid, sim_path, &actions, NULL, argv, environ) != 0) {
+		perror(sim_path);
+		exit(1);
+	}
+	
+	posix_spawn_file_actions_destroy(&actions);
+	
+	close(out[1]);
+	close(err[1]);
+	
+	std::vector<uint8_t> output, summary;
+	read_all(out[0], err[0], output, summary);
+	
+	int status;
+	waitpid(pid, &status, 0);
+	
+	// Out of range settings are refused with 2
+	if(WIFEXITED(status) && WEXITSTATUS(status) == 2) {
+		std::lock_guard<std::mutex> guard(res.lock);
+		res.invalid = true;
+		
+		return;
+	}
+	
+	summary.push_back(0);
+	
+	const char *line = strstr((const char *) summary.data(), "s simulated");
+	unsigned long long samples;
+	unsigned sim_shots, timeouts;
+	
+	if(!WIFEXITED(status) || WEXITSTATUS(status) != 0 || !line || sscanf(line,
+			"s simulated (%llu samples): %u shots, %u timeouts",
+			&samples, &sim_shots, &timeouts) != 3) {
+		
+		fprintf(stderr, "%s: replay failed\n%s", trace.path, (const char *) summary.data());
+		exit(1);
+	}
+	
+	uint64_t cost = 0;
+	
+	for(const char *stage : cost_stages) {
+		char key[32];
+		unsigned long long ns;
+		
+		snprintf(key, sizeof(key), "prof %s ", stage);
+		const char *p = strstr(line, key);
+		
+		if(!p || sscanf(p + strlen(key), "%llu ns", &ns) != 1) {
+			fprintf(stderr, "%s: no \"%s\" in the summary, not profiled?\n", sim_path, stage);
+			exit(1);
+		}
+		
+		cost += ns;
+	}
+	
+	std::vector<proto_shot_t> shots;
+	decode_shots(output, shots);
+	
+	// Both in time order, matched greedily
+	std::vector<bool> matched(trace.labels.size());
+	uint32_t extra = 0;
+	
+	for(const proto_shot_t &shot : shots) {
+		auto it = std::lower_bound(trace.labels.begin(), trace.labels.end(),
+			shot.time_ms - MATCH_TOLERANCE_MS);
+		
+		size_t k = it - trace.labels.begin();
+		
+		while(k < trace.labels.size() && matched[k])
+			k++;
+		
+		if(k < trace.labels.size() && fabs(trace.labels[k] - shot.time_ms) <= MATCH_TOLERANCE_MS)
+			matched[k] = true;
+		else
+			extra++;
+	}
+	
+	uint32_t missed = std::count(matched.begin(), matched.end(), false);
+	
+	std::lock_guard<std::mutex> guard(res.lock);
+	
+	res.labels += trace.labels.size();
+	res.missed += missed;
+	res.extra += extra;
+	res.timeouts += timeouts;
+	res.duration_s += trace.duration_s;
+	
+	res.cost_ns += cost;
+	res.samples += samples;
+}
+
+// Own jobs first, from the front, then steal from the back of the others'
+static bool next_job(uint32_t id, job_t &job) {
+	for(size_t i = 0; i < queues.size(); i++) {
+		worker_queue_t &q = queues[(id + i) % queues.size()];
+		std::lock_guard<std::mutex> guard(q.lock);
+		
+		if(q.jobs.empty())
+			continue;
+		
+		if(i == 0) {
+			job = q.jobs.front();
+			q.jobs.pop_front();
+		} else {
+			job = q.jobs.back();
+			q.jobs.pop_back();
+		}
+		
+		return true;
+	}
+	
+	return false;
+}
+
+static void worker(uint32_t id) {
+	job_t job;
+	
+	while(next_job(id, job))
+		run_job(job);
+}
+
+// -------------------------------------------------
+
+static double miss_rate(const result_t &r) {
+	return r.labels ? (double) r.missed / r.labels : 0;
+}
+
+static double false_rate(const result_t &r) {
+	return r.duration_s > 0 ? (r.extra + r.timeouts) * 60 / r.duration_s : 0;
+}
+
+static double cost_ns(const result_t &r) {
+	return r.samples ? (double) r.cost_ns / r.samples : 0;
+}
+
+static bool dominates(const result_t &a, const result_t &b) {
+	double ma = miss_rate(a), mb = miss_rate(b);
+	double fa = false_rate(a), fb = false_rate(b);
+	double ca = cost_ns(a), cb = cost_ns(b);
+	
+	return ma <= mb && fa <= fb && ca <= cb && (ma < mb || fa < fb || ca < cb);
+}
+
+static void print_header(FILE *out) {
+	fprintf(out, "lag,threshold,influence,miss_rate,false_per_min,cost_ns,"
+		"labels,missed,extra,timeouts\n");
+}
+
+static void print_result(FILE *out, const result_t &r) {
+	fprintf(out, "%u,%u,%u,%.4f,%.3f,%.3f,%u,%u,%u,%u\n",
+		r.params.lag, r.params.threshold, r.params.influence,
+		miss_rate(r), false_rate(r), cost_ns(r),
+		r.labels, r.missed, r.extra, r.timeouts);
+}
+
+// -------------------------------------------------
+
+// "a,b,c" or "first:last[:step]"
+static bool parse_list(const char *str, std::vector<uint16_t> &values) {
+	unsigned first, last, step = 1;
+	int n = sscanf(str, "%u:%u:%u", &first, &last, &step);
+	
+	values.clear();
+	
+	if(n >= 2 && strchr(str, ':')) {
+		if(step == 0 || last < first || last > UINT16_MAX)
+			return false;
+		
+		for(unsigned v = first; v <= last; v += step)
+			values.push_back(v);
+		
+		return true;
+	}
+	
+	for(const char *p = str; *p; ) {
+		char *end;
+		unsigned long v = strtoul(p, &end, 10);
+		
+		if(end == p || v > UINT16_MAX || (*end && *end != ','))
+			return false;
+		
+		values.push_back(v);
+		p = (*end ? end + 1 : end);
+	}
+	
+	return !values.empty();
+}
+
+static bool load_labels(corpus_trace_t &ct) {
+	trace_file_t t;
+	
+	if(!trace_open(t, ct.path))
+		return false;
+	
+	if(!t.shots) {
+		fprintf(stderr, "%s: no shot index, see chrono_sim -x\n", ct.path);
+		trace_close(t);
+		
+		return false;
+	}
+	
+	double period_ms = t.header->period_ps * 1e-9;
+	
+	ct.duration_s = t.num_pairs * period_ms * 1e-3;
+	
+	for(uint32_t i = 0; i < t.num_shots; i++)
+		ct.labels.push_back(t.shots[i].rear_pair * period_ms);
+	
+	std::sort(ct.labels.begin(), ct.labels.end());
+	
+	trace_close(t);
+	return true;
+}
+
+// chrono_sim_prof, next to this tool
+static bool find_sim() {
+	ssize_t n = readlink("/proc/self/exe", sim_path, sizeof(sim_path) - 16);
+	
+	if(n <= 0)
+		return false;
+	
+	sim_path[n] = '\0';
+	
+	char *slash = strrchr(sim_path, '/');
+	strcpy(slash ? slash + 1 : sim_path, "chrono_sim_prof");
+	
+	return access(sim_path, X_OK) == 0;
+}
+
+static int usage(const char *name) {
+	fprintf(stderr, "Usage: %s [-l lags] [-t thresholds] [-i influences] "
+		"[-r count] [-j threads] [-o all.csv] trace...\n", name);
+	return 2;
+}
+
+int main(int argc, char *argv[]) {
+	std::vector<uint16_t> lags, thresholds, influences = {0, 1};
+	const char *all_path = NULL;
+	uint32_t random = 0, threads = std::thread::hardware_concurrency();
+	int opt;
+	
+	parse_list("10:120:10", lags);
+	parse_list("20:200:20", thresholds);
+	
+	while((opt = getopt(argc, argv, "l:t:i:r:j:o:")) != -1) {
+		bool ok = true;
+		
+		switch(opt) {
+			case 'l': ok = parse_list(optarg, lags); break;
+			case 't': ok = parse_list(optarg, thresholds); break;
+			case 'i': ok = parse_list(optarg, influences); break;
+			case 'r': random = atoi(optarg); break;
+			case 'j': threads = atoi(optarg); break;
+			case 'o': all_path = optarg; break;
+			
+			default: return usage(argv[0]);
+		}
+		
+		if(!ok) {
+			fprintf(stderr, "bad list: %s\n", optarg);
+			return 2;
+		}
+	}
+	
+	if(optind == argc || threads == 0)
+		return usage(argv[0]);
+	
+	if(!find_sim()) {
+		fprintf(stderr, "%s not found, see make host\n", sim_path);
+		return 1;
+	}
+	
+	for(int i = optind; i < argc; i++) {
+		corpus.push_back({.path = argv[i]});
+		
+		if(!load_labels(corpus.back()))
+			return 1;
+	}
+	
+	std::vector<params_t> sets;
+	
+	if(random) {
+		std::mt19937 rng(1);
+		
+		for(uint32_t i = 0; i < random; i++) {
+			sets.push_back({
+				lags[rng() % lags.size()],
+				thresholds[rng() % thresholds.size()],
+				influences[rng() % influences.size()]
+			});
+		}
+	} else {
+		for(uint16_t lag : lags)
+		for(uint16_t threshold : thresholds)
+		for(uint16_t influence : influences)
+			sets.push_back({lag, threshold, influence});
+	}
+	
+	results = std::vector<result_t>(sets.size());
+	queues = std::vector<worker_queue_t>(threads);
+	
+	// A set's traces go to the same queue, until stolen
+	for(size_t s = 0; s < sets.size(); s++) {
+		results[s].params = sets[s];
+		
+		for(size_t t = 0; t < corpus.size(); t++)
+			queues[s % threads].jobs.push_back({(uint32_t) s, (uint32_t) t});
+	}
+	
+	fprintf(stderr, "%zu parameter sets, %zu traces, %u threads\n",
+		sets.size(), corpus.size(), threads);
+	
+	std::vector<std::thread> pool;
+	
+	for(uint32_t id = 0; id < threads; id++)
+		pool.emplace_back(worker, id);
+	
+	for(std::thread &t : pool)
+		t.join();
+	
+	std::vector<const result_t *> valid, front;
+	
+	for(const result_t &r : results) {
+		if(!r.invalid)
+			valid.push_back(&r);
+	}
+	
+	for(const result_t *r : valid) {
+		bool dominated = false;
+		
+		for(const result_t *other : valid) {
+			if(dominates(*other, *r)) {
+				dominated = true;
+				break;
+			}
+		}
+		
+		if(!dominated)
+			front.push_back(r);
+	}
+	
+	std::sort(front.begin(), front.end(), [](const result_t *a, const result_t *b) {
+		if(miss_rate(*a) != miss_rate(*b))
+			return miss_rate(*a) < miss_rate(*b);
+		
+		return false_rate(*a) < false_rate(*b);
+	});
+	
+	if(all_path) {
+		FILE *all = fopen(all_path, "w");
+		
+		if(!all) {
+			perror(all_path);
+			return 1;
+		}
+		
+		print_header(all);
+		
+		for(const result_t *r : valid)
+			print_result(all, *r);
+		
+		fclose(all);
+	}
+	
+	fprintf(stderr, "%zu valid, %zu on the Pareto front\n", valid.size(), front.size());
+	
+	print_header(stdout);
+	
+	for(const result_t *r : front)
+		print_result(stdout, *r);
+	
+	return 0;
+}
@@ -0,0 +1,105 @@
+/**
+ * Command interface on a pseudo-terminal.
+ *
+ * Runs command.cpp and settings.cpp on a pty that stands in for
+ * the VCP. Connect to the printed device with a terminal program,
+ * or a test script. Actions that would touch the hardware are
+ * printed on stderr instead. With -s, commands are read from stdin
+ * and replies written to stdout, for scripting without a pty.
+ *
+ * Usage: cmd_pty [-s]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <termios.h>
+
+#include "../chronograph.h"
+#include "../settings.h"
+#include "../command.h"
+
+// -------------------------------------------------
+
+chrono_counters_t counters;
+
+static int out_fd = 1;
+
+static void output(const char *str) {
+	if(write(out_fd, str, strlen(str)) < 0)
+		perror("write");
+}
+
+static void report(uint8_t actions) {
+	static const char *const names[] = {
+		"apply peak", "apply adc", "apply stat", "reset", "page", "save", "stream"
+	};
+	
+	for(int i = 0; i < 7; i++) {
+		if(actions & (1 << i))
+			fprintf(stderr, "[%s]\n", names[i]);
+	}
+	
+	// No flash on the host
+	if(actions & CMD_SAVE)
+		output("OK\n");
+}
+
+static int open_pty() {
+	int fd = posix_openpt(O_RDWR | O_NOCTTY);
+	
+	if(fd < 0 || grantpt(fd) != 0 || unlockpt(fd) != 0) {
+		perror("pty");
+		exit(1);
+	}
+	
+	// Raw, like the VCP. Kept open, so that reads don't fail
+	// while no client is connected.
+	int slave = open(ptsname(fd), O_RDWR | O_NOCTTY);
+	struct termios tio;
+	
+	if(slave < 0 || tcgetattr(slave, &tio) != 0) {
+		perror(ptsname(fd));
+		exit(1);
+	}
+	
+	cfmakeraw(&tio);
+	tcsetattr(slave, TCSANOW, &tio);
+	
+	printf("%s\n", ptsname(fd));
+	fflush(stdout);
+	
+	return fd;
+}
+
+int main(int argc, char *argv[]) {
+	int in_fd = 0;
+	
+	if(argc > 1 && strcmp(argv[1], "-s") == 0) {
+		in_fd = 0;
+		out_fd = 1;
+	} else if(argc > 1) {
+		fprintf(stderr, "Usage: %s [-s]\n", argv[0]);
+		return 2;
+	} else
+		in_fd = out_fd = open_pty();
+	
+	settings_defaults(settings);
+	
+	cmd_line_t line = {};
+	char buf[64];
+	ssize_t n;
+	
+	while((n = read(in_fd, buf, sizeof(buf))) > 0) {
+		for(ssize_t i = 0; i < n; i++) {
+			uint8_t actions = cmd_input(line, buf[i], output);
+			
+			if(actions)
+				report(actions);
+		}
+	}
+	
+	return 0;
+}
@@ -0,0 +1,135 @@
+/**
+ * SSD1306 display emulator.
+ *
+ * Runs display.cpp and ssd1306.cpp against the emulated controller
+ * of ssd1306_host.cpp, for a series of shots, and dumps the result
+ * as PBM images: what the panel shows (-o), and the library's
+ * screenbuffer (-b). The panel may be compared with a reference
+ * image (-c), failing on any differing pixel. `make check` does so
+ * with the golden images in host/golden.
+ *
+ * Usage: display_emu [-p page] [-m mode] [-w weight] [-o panel.pbm]
+ *          [-b buffer.pbm] [-c reference.pbm] [-l] [shot...]
+ *
+ * Shots are measurements, in the mode's unit. The bytes transferred
+ * for each redraw are printed, with their time on the wire.
+ * display_emu_spi does the same for the SPI transport.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../chronograph.h"
+#include "../display.h"
+#include "ssd1306_host.h"
+
+// -------------------------------------------------
+
+// Shown on the diagnostics page
+chrono_counters_t counters;
+
+static void print_update(const char *what, ssd1306_host_stats_t &prev) {
+	ssd1306_host_stats_t &now = ssd1306_host_stats;
+	
+	uint32_t bytes = now.bytes - prev.bytes;
+	
+	printf("%-12s transfers %3u bytes %5u (commands %3u data %5u) %6u us\n",
+		what, now.transfers - prev.transfers, bytes,
+		now.commands - prev.commands, now.data - prev.data,
+		ssd1306_host_wire_us(bytes));
+	
+	prev = now;
+}
+
+static int compare(const char *path, const uint8_t *panel) {
+	uint8_t reference[SSD1306_PAGES * SSD1306_WIDTH];
+	int diff = 0;
+	
+	if(!ssd1306_host_read_pbm(path, reference)) {
+		fprintf(stderr, "%s: not a %dx%d PBM (P4) image\n",
+			path, SSD1306_WIDTH, SSD1306_HEIGHT);
+		return -1;
+	}
+	
+	for(size_t i = 0; i < sizeof(reference); i++)
+		diff += __builtin_popcount(reference[i] ^ panel[i]);
+	
+	return diff;
+}
+
+int main(int argc, char *argv[]) {
+	const char *panel_path = NULL, *buffer_path = NULL, *ref_path = NULL;
+	chrono_stat_t stat = {.mode = mode_fps, .weight = WEIGHT};
+	int page = 0, opt;
+	
+	while((opt = getopt(argc, argv, "p:m:w:o:b:c:l")) != -1) {
+		switch(opt) {
+			case 'p': page = atoi(optarg); break;
+			case 'm': stat.mode = (chrono_mode_t) atoi(optarg); break;
+			case 'w': stat.weight = atoi(optarg); break;
+			case 'o': panel_path = optarg; break;
+			case 'b': buffer_path = optarg; break;
+			case 'c': ref_path = optarg; break;
+			case 'l': ssd1306_host_log(stdout); break;
+			
+			default:
+				fprintf(stderr, "Usage: %s [-p page] [-m mode] [-w weight] "
+					"[-o panel.pbm] [-b buffer.pbm] [-c reference.pbm] "
+					"[-l] [shot...]\n", argv[0]);
+				return 2;
+		}
+	}
+	
+	ssd1306_host_stats_t prev = {};
+	
+	display_init();
+	print_update("init", prev);
+	
+	for(int i = 0; i < page; i++)
+		display_next_page();
+	
+	display_draw(stat);
+	print_update("draw", prev);
+	
+	for(int i = optind; i < argc; i++) {
+		chrono_stat_update(stat, atof(argv[i]));
+		counters.shots++;
+		
+		display_draw(stat);
+		
+		print_update("shot", prev);
+	}
+	
+	uint8_t panel[SSD1306_PAGES * SSD1306_WIDTH];
+	ssd1306_host_panel(panel);
+	
+	if(panel_path && !ssd1306_host_write_pbm(panel_path, panel)) {
+		perror(panel_path);
+		return 1;
+	}
+	
+	if(buffer_path && !ssd1306_host_write_pbm(buffer_path, ssd1306_GetBuffer())) {
+		perror(buffer_path);
+		return 1;
+	}
+	
+	// The panel must always match the screenbuffer
+	if(memcmp(panel, ssd1306_GetBuffer(), sizeof(panel)) != 0) {
+		fprintf(stderr, "Panel differs from the screenbuffer\n");
+		return 1;
+	}
+	
+	if(ref_path) {
+		int diff = compare(ref_path, panel);
+		
+		if(diff) {
+			if(diff > 0)
+				fprintf(stderr, "%s: %d pixels differ\n", ref_path, diff);
+			return 1;
+		}
+	}
+	
+	return 0;
+}
@@ -0,0 +1,139 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <poll.h>
+
+#include "../hal.h"
+#include "../settings.h"
+#include "../stream.h"
+
+// -------------------------------------------------
+
+hal_sim_t hal_sim;
+
+// Read ahead by vcp_available()
+static int vcp_next = -1;
+
+// -------------------------------------------------
+
+void hal_sim_run() {
+	uint64_t target = hal_sim.now_ns;
+	
+	while(1) {
+		uint64_t timeout = UINT64_MAX;
+		
+		if(hal_sim.timer_running)
+			timeout = hal_sim.timer_start_ns + HAL_SIM_TIMEOUT_NS;
+		
+		if(timeout <= target) {
+			hal_sim.now_ns = timeout;
+			
+			// One-pulse mode, the counter stops at 0
+			hal_sim.timer_running = false;
+			hal_sim.timer_count = 0;
+			
+			chrono_timeout_isr();
+		} else {
+			hal_sim.due_ns = timeout;
+			break;
+		}
+	}
+	
+	hal_sim.now_ns = target;
+	
+	if(hal_sim.end_ns) {
+		if(hal_sim.now_ns >= hal_sim.end_ns)
+			hal_sim.end();
+		
+		if(hal_sim.end_ns < hal_sim.due_ns)
+			hal_sim.due_ns = hal_sim.end_ns;
+	}
+}
+
+// -------------------------------------------------
+
+void hal_init() {
+	millis_init();
+	vcp_init();
+}
+
+void gpio_adc_init() {}
+
+void adc_init(uint8_t sample_time, uint8_t prescaler) {
+	chrono_settings_t s = settings;
+	
+	s.adc_sample_time = sample_time;
+	s.adc_prescaler = prescaler;
+	
+	hal_sim.sample_ns = settings_sample_period_ns(s);
+	hal_sim.convert_ns = settings_conversion_ps(s) / 1000;
+}
+
+void timer_init() {
+	hal_sim.timer_running = false;
+	hal_sim.timer_count = 0;
+}
+
+void cmd_intake_init() {
+	hal_sim.intake_running = true;
+	hal_sim.intake_next_ns = hal_sim.now_ns + 1000000000 / CMD_INTAKE_HZ;
+}
+
+// The DMA stream isn't simulated
+void stream_run(bool (*stop)()) {
+	vcp_printf("ERR not simulated\n");
+}
+
+// -------------------------------------------------
+
+void millis_init() {}
+
+uint32_t millis() {
+	return hal_sim.now_ns / 1000000;
+}
+
+void vcp_init() {}
+
+int vcp_printf(const char *format, ...) {
+	va_list args;
+	va_start(args, format);
+	
+	int n = vprintf(format, args);
+	
+	va_end(args);
+	return n;
+}
+
+void vcp_send(const uint8_t *data, size_t len) {
+	if(hal_sim.output) {
+		hal_sim.output(data, len);
+		return;
+	}
+	
+	fwrite(data, 1, len, stdout);
+}
+
+// Commands come from stdin, if any
+int vcp_available() {
+	if(vcp_next >= 0)
+		return 1;
+	
+	struct pollfd pfd = {.fd = 0, .events = POLLIN};
+	unsigned char c;
+	
+	if(poll(&pfd, 1, 0) <= 0 || read(0, &c, 1) != 1)
+		return 0;
+	
+	vcp_next = c;
+	return 1;
+}
+
+int vcp_read() {
+	if(!vcp_available())
+		return -1;
+	
+	int c = vcp_next;
+	vcp_next = -1;
+	
+	return c;
+}
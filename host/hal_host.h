@@ -0,0 +1,153 @@
+#ifndef HAL_HOST_H
+#define HAL_HOST_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "../chronograph.h"
+
+/* Host HAL, see hal.h. The peripherals are simulated on a virtual
+ * clock, which only advances with ADC conversions: each adc_read()
+ * takes the sample period of the measurement loop, as modelled by
+ * settings_sample_period_ns(). The timers and their "interrupts"
+ * are driven by this clock, so a run is deterministic, and doesn't
+ * depend on the host's speed.
+ *
+ * The ADC's input is a callback, sampled once the conversion
+ * time has passed. */
+
+// Value of an ADC channel at a time
+typedef uint16_t (*hal_source_t)(uint8_t channel, uint64_t time_ns);
+
+typedef struct {
+	uint64_t now_ns;
+	
+	// Per adc_read(), and until its value is sampled
+	uint32_t sample_ns;
+	uint32_t convert_ns;
+	
+	uint8_t channel;
+	hal_source_t source;
+	uint64_t conversions;
+	
+	// Binary VCP output (vcp_send()), to stdout if NULL
+	void (*output)(const uint8_t *data, size_t len);
+	
+	// TIM2
+	bool timer_running;
+	uint64_t timer_start_ns;
+	uint16_t timer_count;
+	
+	// Command intake timer
+	bool intake_running;
+	uint64_t intake_next_ns;
+	
+	// Called once the clock reaches end_ns, unless 0. Must not return.
+	uint64_t end_ns;
+	void (*end)();
+	
+	// The clock can advance up to here without running anything
+	uint64_t due_ns;
+} hal_sim_t;
+
+extern hal_sim_t hal_sim;
+
+// Runs the "interrupts" that fell due, in order
+void hal_sim_run();
+
+inline void hal_sim_advance(uint64_t ns) {
+	hal_sim.now_ns += ns;
+	
+	if(hal_sim.now_ns >= hal_sim.due_ns)
+		hal_sim_run();
+}
+
+// Time of TIM2's overflow, once started
+#define HAL_SIM_TIMEOUT_NS (((uint64_t) TIMER_ARR + 1) * 1000000000 / TIMER_FREQ)
+
+// -------------------------------------------------
+
+void hal_init();
+
+void gpio_adc_init();
+void adc_init(uint8_t sample_time, uint8_t prescaler);
+
+void timer_init();
+void cmd_intake_init();
+
+// -------------------------------------------------
+
+inline void adc_channel(uint8_t channel) {
+	hal_sim.channel = channel;
+}
+
+inline uint32_t adc_read() {
+	uint16_t value = hal_sim.source(hal_sim.channel,
+		hal_sim.now_ns + hal_sim.convert_ns);
+	
+	hal_sim.conversions++;
+	hal_sim_advance(hal_sim.sample_ns);
+	
+	return value;
+}
+
+inline uint16_t timer_read() {
+	if(!hal_sim.timer_running)
+		return hal_sim.timer_count;
+	
+	return (hal_sim.now_ns - hal_sim.timer_start_ns)
+		* TIMER_FREQ / 1000000000;
+}
+
+inline void timer_start() {
+	hal_sim.timer_running = true;
+	hal_sim.timer_start_ns = hal_sim.now_ns;
+	
+	if(hal_sim.now_ns + HAL_SIM_TIMEOUT_NS < hal_sim.due_ns)
+		hal_sim.due_ns = hal_sim.now_ns + HAL_SIM_TIMEOUT_NS;
+}
+
+inline void timer_stop() {
+	hal_sim.timer_count = timer_read();
+	hal_sim.timer_running = false;
+}
+
+// A period passed since the last call, as TIM3's update flag
+inline bool cmd_intake_due() {
+	const uint64_t period = 1000000000 / CMD_INTAKE_HZ;
+	
+	if(!hal_sim.intake_running || hal_sim.now_ns < hal_sim.intake_next_ns)
+		return false;
+	
+	hal_sim.intake_next_ns += (hal_sim.now_ns - hal_sim.intake_next_ns) / period * period + period;
+	return true;
+}
+
+inline void hal_cycles_init() {}
+
+// At 72 MHz, as on the target
+inline uint32_t hal_cycles() {
+	return hal_sim.now_ns * 72 / 1000;
+}
+
+/* Flash page, in RAM. Inline, so that the host tools that
+ * only use settings.cpp don't need the simulation. */
+inline uint8_t *hal_flash_mem() {
+	static uint8_t page[1024];
+	return page;
+}
+
+inline const void *hal_flash_page() {
+	return hal_flash_mem();
+}
+
+inline bool hal_flash_write(const void *src, size_t len) {
+	if(len > 1024)
+		return false;
+	
+	memcpy(hal_flash_mem(), src, len);
+	return true;
+}
+
+#endif
@@ -0,0 +1,14 @@
+/**
+ * Host stand-in for stm32core's millis header. Implemented
+ * by host/hal_host.cpp, on the virtual clock.
+ */
+
+#ifndef HOST_CORE_MILLIS_H
+#define HOST_CORE_MILLIS_H
+
+#include <stdint.h>
+
+void millis_init();
+uint32_t millis();
+
+#endif
@@ -0,0 +1,11 @@
+/**
+ * Host stand-in for stm32core's types header.
+ */
+
+#ifndef HOST_CORE_TYPES_H
+#define HOST_CORE_TYPES_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#endif
@@ -0,0 +1,19 @@
+/**
+ * Host stand-in for stm32core's VCP header. Implemented by
+ * host/hal_host.cpp, on stdin and stdout.
+ */
+
+#ifndef HOST_CORE_USB_VCP_H
+#define HOST_CORE_USB_VCP_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+void vcp_init();
+int vcp_printf(const char *format, ...);
+void vcp_send(const uint8_t *data, size_t len);
+
+int vcp_available();
+int vcp_read();
+
+#endif
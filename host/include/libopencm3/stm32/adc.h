@@ -0,0 +1,21 @@
+/**
+ * Host stand-in for libopencm3's ADC header. Only provides the
+ * constants used by the portable headers (chronograph.h).
+ */
+
+#ifndef HOST_LIBOPENCM3_ADC_H
+#define HOST_LIBOPENCM3_ADC_H
+
+#define ADC_CHANNEL0 0x00
+#define ADC_CHANNEL1 0x01
+
+#define ADC_SMPR_SMP_1DOT5CYC 0x0
+#define ADC_SMPR_SMP_7DOT5CYC 0x1
+#define ADC_SMPR_SMP_13DOT5CYC 0x2
+#define ADC_SMPR_SMP_28DOT5CYC 0x3
+#define ADC_SMPR_SMP_41DOT5CYC 0x4
+#define ADC_SMPR_SMP_55DOT5CYC 0x5
+#define ADC_SMPR_SMP_71DOT5CYC 0x6
+#define ADC_SMPR_SMP_239DOT5CYC 0x7
+
+#endif
@@ -0,0 +1,237 @@
+/**
+ * Shot stream decoder.
+ *
+ * Reads protocol.h frames from a file, the VCP's tty, or stdin,
+ * and writes the shot records as CSV. Bytes outside of valid
+ * frames (e.g. text output before switching to binary mode)
+ * are skipped. Lost and corrupt frames are reported on stderr.
+ *
+ * Log records (see log.h) are formatted, to stderr or the -l file.
+ * Trigger snapshots (see snapshot.h) are written as CSV to the
+ * -s file, one sample per row, offset from the trigger sample.
+ *
+ * Usage: shotdec [-o out.csv] [-l out.log] [-s snap.csv] [input]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <termios.h>
+
+#include "../protocol.h"
+#include "../log.h"
+#include "../snapshot.h"
+
+// -------------------------------------------------
+
+#define MPS_TO_FPS 3.2808398950131
+
+typedef struct {
+	uint32_t frames;
+	uint32_t corrupt;
+	uint32_t lost;
+	uint32_t unknown;
+	
+	bool have_seq;
+	uint16_t next_seq;
+} stats_t;
+
+static void print_shot(FILE *out, const proto_shot_t &shot) {
+	double dt_us = (double) shot.ticks * 1e6 / shot.timer_freq;
+	
+	fprintf(out, "%u,%u,%u,%.3f,%u,%.3f,%.3f,%u,%u,%u\n",
+		shot.header.seq, shot.time_ms, shot.ticks, dt_us,
+		shot.distance_um, shot.speed, shot.speed * MPS_TO_FPS,
+		shot.front_peak, shot.rear_peak, shot.timeouts);
+}
+
+static void print_log(FILE *log, const uint8_t *record, int len) {
+	proto_log_t rec;
+	memcpy(&rec, record, len);
+	
+	if(rec.dropped)
+		fprintf(log, "%u log entries dropped\n", rec.dropped);
+	
+	int words = (len - (int) offsetof(proto_log_t, words)) / 4;
+	
+	for(int i = 0; i + 2 <= words; ) {
+		uint32_t header = rec.words[i];
+		uint32_t args[LOG_ARGS_MAX] = {};
+		
+		int nargs = LOG_HEADER_NARGS(header);
+		const char *format = log_format(LOG_HEADER_ID(header));
+		
+		if(nargs > LOG_ARGS_MAX || i + 2 + nargs > words || !format) {
+			fprintf(log, "bad log entry 0x%08x\n", header);
+			return;
+		}
+		
+		for(int a = 0; a < nargs; a++)
+			args[a] = rec.words[i + 2 + a];
+		
+		fprintf(log, "[%u] ", rec.words[i + 1]);
+		fprintf(log, format, args[0], args[1], args[2]);
+		fprintf(log, "\n");
+		
+		i += 2 + nargs;
+	}
+	
+	fflush(log);
+}
+
+static void print_snap(FILE *snap_out, const uint8_t *record) {
+	proto_snap_t snap;
+	memcpy(&snap, record, sizeof(snap));
+	
+	for(int i = 0; i < SNAP_WINDOW; i++) {
+		fprintf(snap_out, "%u,%s,%d,%u\n", snap.shot,
+			snap.trigger == SNAP_FRONT ? "front" : "rear",
+			i - snap.pre, snap.samples[i]);
+	}
+	
+	fflush(snap_out);
+}
+
+static void handle_frame(FILE *out, FILE *log, FILE *snap_out,
+		stats_t &st, const uint8_t *frame, size_t len) {
+	
+	uint8_t record[PROTO_RECORD_MAX];
+	int n = proto_decode(frame, len, record);
+	
+	if(n < (int) sizeof(proto_header_t)) {
+		st.corrupt++;
+		return;
+	}
+	
+	proto_header_t header;
+	memcpy(&header, record, sizeof(header));
+	
+	st.frames++;
+	
+	if(st.have_seq && header.seq != st.next_seq) {
+		uint16_t gap = header.seq - st.next_seq;
+		
+		fprintf(stderr, "seq %u: %u frame(s) lost\n", header.seq, gap);
+		st.lost += gap;
+	}
+	
+	st.have_seq = true;
+	st.next_seq = header.seq + 1;
+	
+	if(header.type == PROTO_SHOT && n == sizeof(proto_shot_t)) {
+		proto_shot_t shot;
+		memcpy(&shot, record, sizeof(shot));
+		
+		print_shot(out, shot);
+		fflush(out);
+	} else if(header.type == PROTO_LOG && n >= (int) offsetof(proto_log_t, words))
+		print_log(log, record, n);
+	else if(header.type == PROTO_SNAP && n == sizeof(proto_snap_t)) {
+		if(snap_out)
+			print_snap(snap_out, record);
+	} else
+		st.unknown++;
+}
+
+// Raw mode, if reading from the VCP's tty
+static void tty_raw(int fd) {
+	struct termios tio;
+	
+	if(tcgetattr(fd, &tio) != 0)
+		return;
+	
+	cfmakeraw(&tio);
+	tcsetattr(fd, TCSANOW, &tio);
+}
+
+int main(int argc, char *argv[]) {
+	const char *out_path = NULL, *log_path = NULL, *snap_path = NULL;
+	FILE *out = stdout, *log = stderr, *snap_out = NULL;
+	int fd = 0, opt;
+	
+	while((opt = getopt(argc, argv, "o:l:s:")) != -1) {
+		switch(opt) {
+			case 'o': out_path = optarg; break;
+			case 'l': log_path = optarg; break;
+			case 's': snap_path = optarg; break;
+			
+			default:
+				fprintf(stderr, "Usage: %s [-o out.csv] [-l out.log] [-s snap.csv] [input]\n", argv[0]);
+				return 2;
+		}
+	}
+	
+	if(optind < argc && (fd = open(argv[optind], O_RDONLY | O_NOCTTY)) < 0) {
+		perror(argv[optind]);
+		return 1;
+	}
+	
+	if(out_path && !(out = fopen(out_path, "w"))) {
+		perror(out_path);
+		return 1;
+	}
+	
+	if(log_path && !(log = fopen(log_path, "w"))) {
+		perror(log_path);
+		return 1;
+	}
+	
+	if(snap_path) {
+		if(!(snap_out = fopen(snap_path, "w"))) {
+			perror(snap_path);
+			return 1;
+		}
+		
+		fprintf(snap_out, "shot,trigger,offset,value\n");
+	}
+	
+	tty_raw(fd);
+	
+	fprintf(out, "seq,time_ms,ticks,dt_us,distance_um,"
+		"speed_mps,speed_fps,front_peak,rear_peak,timeouts\n");
+	
+	stats_t st = {};
+	
+	uint8_t frame[PROTO_FRAME_MAX];
+	size_t len = 0;
+	bool overflow = false;
+	
+	uint8_t buf[256];
+	ssize_t n;
+	
+	while((n = read(fd, buf, sizeof(buf))) > 0) {
+		for(ssize_t i = 0; i < n; i++) {
+			if(buf[i] != 0) {
+				if(len < sizeof(frame))
+					frame[len++] = buf[i];
+				else
+					overflow = true;
+				
+				continue;
+			}
+			
+			// Delimiter. Runs of non-frame bytes are too long to be frames.
+			if(overflow)
+				st.corrupt++;
+			else if(len)
+				handle_frame(out, log, snap_out, st, frame, len);
+			
+			len = 0;
+			overflow = false;
+		}
+	}
+	
+	fprintf(stderr, "%u frames, %u lost, %u corrupt, %u unknown\n",
+		st.frames, st.lost, st.corrupt, st.unknown);
+	
+	if(out != stdout)
+		fclose(out);
+	if(log != stderr)
+		fclose(log);
+	if(snap_out)
+		fclose(snap_out);
+	
+	return 0;
+}
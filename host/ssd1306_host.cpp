@@ -0,0 +1,256 @@
+/**
+ * Host SSD1306 transport (SSD1306_USE_HOST).
+ *
+ * Transfers complete synchronously, as soon as they are queued,
+ * into an emulated controller. The wire is modeled after the I2C
+ * transport, or the SPI one when built with SSD1306_HOST_SPI.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "ssd1306_host.h"
+
+// -------------------------------------------------
+
+ssd1306_host_stats_t ssd1306_host_stats;
+
+static FILE *log_file;
+
+static struct {
+	uint8_t ram[SSD1306_PAGES][SSD1306_WIDTH];
+	
+	// 0 horizontal, 1 vertical, 2 page addressing
+	uint8_t mode;
+	
+	uint8_t col, col_start, col_end;
+	uint8_t page, page_start, page_end;
+	
+	bool seg_remap, com_remap, inverse, on;
+	
+	// Current multi-byte command and its arguments
+	uint8_t cmd, args[6], nargs, expected;
+} ctl = {
+	.mode = 2,
+	.col_end = SSD1306_WIDTH - 1,
+	.page_end = SSD1306_PAGES - 1,
+};
+
+// -------------------------------------------------
+
+static uint8_t cmd_args(uint8_t cmd) {
+	switch(cmd) {
+		case 0x20: case 0x81: case 0x8D: case 0xA8: case 0xD3:
+		case 0xD5: case 0xD9: case 0xDA: case 0xDB:
+			return 1;
+		case 0x21: case 0x22: case 0xA3:
+			return 2;
+		case 0x29: case 0x2A:
+			return 5;
+		case 0x26: case 0x27:
+			return 6;
+		default:
+			return 0;
+	}
+}
+
+static void cmd_exec(uint8_t cmd, const uint8_t *args) {
+	if(cmd == 0x20) {
+		ctl.mode = args[0] & 0x3;
+	} else if(cmd == 0x21) {
+		ctl.col = ctl.col_start = args[0] % SSD1306_WIDTH;
+		ctl.col_end = args[1] % SSD1306_WIDTH;
+	} else if(cmd == 0x22) {
+		ctl.page = ctl.page_start = args[0] % SSD1306_PAGES;
+		ctl.page_end = args[1] % SSD1306_PAGES;
+	} else if(cmd >= 0xB0 && cmd <= 0xB7) {
+		ctl.page = (cmd & 0x7) % SSD1306_PAGES;
+	} else if(cmd <= 0x0F) {
+		ctl.col = (ctl.col & 0xF0) | cmd;
+	} else if(cmd >= 0x10 && cmd <= 0x1F) {
+		ctl.col = ((ctl.col & 0x0F) | (cmd & 0xF) << 4) % SSD1306_WIDTH;
+	} else if(cmd == 0xA0 || cmd == 0xA1) {
+		ctl.seg_remap = cmd & 1;
+	} else if(cmd == 0xC0 || cmd == 0xC8) {
+		ctl.com_remap = (cmd == 0xC8);
+	} else if(cmd == 0xA6 || cmd == 0xA7) {
+		ctl.inverse = cmd & 1;
+	} else if(cmd == 0xAE || cmd == 0xAF) {
+		ctl.on = cmd & 1;
+	}
+}
+
+static void cmd_byte(uint8_t byte) {
+	if(ctl.expected) {
+		ctl.args[ctl.nargs++] = byte;
+		
+		if(ctl.nargs < ctl.expected)
+			return;
+		
+		ctl.expected = 0;
+		cmd_exec(ctl.cmd, ctl.args);
+		return;
+	}
+	
+	ctl.cmd = byte;
+	ctl.nargs = 0;
+	ctl.expected = cmd_args(byte);
+	
+	if(!ctl.expected)
+		cmd_exec(byte, NULL);
+}
+
+static void data_byte(uint8_t byte) {
+	ctl.ram[ctl.page][ctl.col] = byte;
+	
+	if(ctl.mode == 1) {
+		// Vertical
+		if(ctl.page++ >= ctl.page_end) {
+			ctl.page = ctl.page_start;
+			ctl.col = (ctl.col >= ctl.col_end ? ctl.col_start : ctl.col + 1);
+		}
+	} else if(ctl.mode == 0) {
+		// Horizontal
+		if(ctl.col++ >= ctl.col_end) {
+			ctl.col = ctl.col_start;
+			ctl.page = (ctl.page >= ctl.page_end ? ctl.page_start : ctl.page + 1);
+		}
+	} else {
+		// Page, wraps within the page
+		ctl.col = (ctl.col + 1) % SSD1306_WIDTH;
+	}
+}
+
+// -------------------------------------------------
+
+void ssd1306_TransportInit(void) {}
+
+void ssd1306_TransportKick(void) {
+	SSD1306_XFER *xfer;
+	
+	while((xfer = ssd1306_TransferPeek())) {
+		ssd1306_host_stats.transfers++;
+		ssd1306_host_stats.commands += xfer->NumCmds;
+		ssd1306_host_stats.data += xfer->Len;
+
+#if defined(SSD1306_HOST_SPI)
+		// Commands and data, D/C# selects between them
+		ssd1306_host_stats.bytes += xfer->NumCmds + xfer->Len;
+#else
+		// Address, control byte(s), commands, data
+		ssd1306_host_stats.bytes += 1 + (xfer->Len ? 2 * xfer->NumCmds + 1
+			: 1 + xfer->NumCmds) + xfer->Len;
+#endif
+
+		if(log_file) {
+			fprintf(log_file, "xfer cmds %u:", xfer->NumCmds);
+			
+			for(int i = 0; i < xfer->NumCmds; i++)
+				fprintf(log_file, " %02X", xfer->Cmds[i]);
+			
+			fprintf(log_file, " data %u\n", xfer->Len);
+		}
+		
+		for(int i = 0; i < xfer->NumCmds; i++)
+			cmd_byte(xfer->Cmds[i]);
+		
+		for(int i = 0; i < xfer->Len; i++)
+			data_byte(xfer->Data[i]);
+		
+		ssd1306_TransferDone();
+	}
+}
+
+void ssd1306_Reset(void) {}
+
+// -------------------------------------------------
+
+uint32_t ssd1306_host_wire_us(uint32_t bytes) {
+	return (uint64_t) bytes * SSD1306_HOST_BYTE_NS / 1000;
+}
+
+void ssd1306_host_log(FILE *f) {
+	log_file = f;
+}
+
+void ssd1306_host_panel(uint8_t *pages) {
+	memset(pages, 0, SSD1306_PAGES * SSD1306_WIDTH);
+	
+	if(!ctl.on)
+		return;
+	
+	/* The library's default (0xA1, 0xC8) shows RAM column 0 at
+	 * the left and RAM row 0 at the top, on a panel mounted the
+	 * way it expects. Clearing either flag mirrors the image. */
+	for(int y = 0; y < SSD1306_HEIGHT; y++) {
+		int row = (ctl.com_remap ? y : SSD1306_HEIGHT - 1 - y);
+		
+		for(int x = 0; x < SSD1306_WIDTH; x++) {
+			int col = (ctl.seg_remap ? x : SSD1306_WIDTH - 1 - x);
+			bool on = (ctl.ram[row / 8][col] >> (row % 8)) & 1;
+			
+			if(on != ctl.inverse)
+				pages[(y / 8) * SSD1306_WIDTH + x] |= 1 << (y % 8);
+		}
+	}
+}
+
+bool ssd1306_host_write_pbm(const char *path, const uint8_t *pages) {
+	FILE *f = fopen(path, "wb");
+	
+	if(!f)
+		return false;
+	
+	fprintf(f, "P4\n%d %d\n", SSD1306_WIDTH, SSD1306_HEIGHT);
+	
+	for(int y = 0; y < SSD1306_HEIGHT; y++) {
+		for(int x = 0; x < SSD1306_WIDTH; x += 8) {
+			uint8_t byte = 0;
+			
+			for(int b = 0; b < 8; b++) {
+				if((pages[(y / 8) * SSD1306_WIDTH + x + b] >> (y % 8)) & 1)
+					byte |= 0x80 >> b;
+			}
+			
+			fputc(byte, f);
+		}
+	}
+	
+	return fclose(f) == 0;
+}
+
+bool ssd1306_host_read_pbm(const char *path, uint8_t *pages) {
+	FILE *f = fopen(path, "rb");
+	int width, height;
+	
+	if(!f)
+		return false;
+	
+	if(fscanf(f, "P4 %d %d", &width, &height) != 2
+			|| width != SSD1306_WIDTH || height != SSD1306_HEIGHT
+			|| fgetc(f) == EOF) {
+		fclose(f);
+		return false;
+	}
+	
+	memset(pages, 0, SSD1306_PAGES * SSD1306_WIDTH);
+	
+	for(int y = 0; y < SSD1306_HEIGHT; y++) {
+		for(int x = 0; x < SSD1306_WIDTH; x += 8) {
+			int byte = fgetc(f);
+			
+			if(byte == EOF) {
+				fclose(f);
+				return false;
+			}
+			
+			for(int b = 0; b < 8; b++) {
+				if(byte & (0x80 >> b))
+					pages[(y / 8) * SSD1306_WIDTH + x + b] |= 1 << (y % 8);
+			}
+		}
+	}
+	
+	fclose(f);
+	return true;
+}
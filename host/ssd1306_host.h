@@ -0,0 +1,47 @@
+#ifndef SSD1306_HOST_H
+#define SSD1306_HOST_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "../ssd1306/ssd1306.h"
+
+/* Host SSD1306 transport, emulating the controller: the command
+ * stream is decoded and data is written to an emulated GDDRAM,
+ * following the addressing mode and window. */
+
+// Time per byte on the wire: 9 bits at 400 kHz (I2C),
+// or 8 bits at 9 MHz (SPI)
+#if defined(SSD1306_HOST_SPI)
+#define SSD1306_HOST_BYTE_NS 889
+#else
+#define SSD1306_HOST_BYTE_NS 22500
+#endif
+
+typedef struct {
+	uint32_t transfers;
+	
+	/* Bytes on the wire. I2C: address, control bytes,
+	 * commands and data. SPI: commands and data. */
+	uint32_t bytes;
+	
+	uint32_t commands;
+	uint32_t data;
+} ssd1306_host_stats_t;
+
+extern ssd1306_host_stats_t ssd1306_host_stats;
+
+// Estimated time to send the bytes, at the transport's clock
+uint32_t ssd1306_host_wire_us(uint32_t bytes);
+
+// Log every command/data transfer, NULL to disable
+void ssd1306_host_log(FILE *f);
+
+// Emulated GDDRAM, as shown on the panel (remapping and inversion applied)
+void ssd1306_host_panel(uint8_t *pages);
+
+// 1 bpp PBM (P4) image from a buffer in the display's RAM layout
+bool ssd1306_host_write_pbm(const char *path, const uint8_t *pages);
+bool ssd1306_host_read_pbm(const char *path, uint8_t *pages);
+
+#endif
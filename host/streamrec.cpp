@@ -0,0 +1,234 @@
+/**
+ * Raw ADC stream receiver.
+ *
+ * Starts streaming (see stream.h) on the VCP's tty, and writes the
+ * samples as a trace file (see trace.h), until the time limit or
+ * Ctrl-C, then stops the stream. The input may also be a file, or
+ * stdin, holding a previously captured stream.
+ *
+ * Dropped blocks are written as gaps, and reported on stderr. The
+ * trace is written once the first block arrives, with its sample
+ * period and gate distance, and gets an empty shot index.
+ *
+ * Usage: streamrec [-t seconds] -o out.trace [input]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <termios.h>
+
+#include "../protocol.h"
+#include "../stream.h"
+#include "trace_file.h"
+
+// -------------------------------------------------
+
+typedef struct {
+	uint32_t frames;
+	uint32_t corrupt;
+	uint32_t blocks;
+	uint32_t gaps;
+	
+	bool started;
+	uint32_t next_block;
+	uint32_t dropped;
+} stats_t;
+
+static volatile sig_atomic_t interrupted;
+
+static void on_signal(int) {
+	interrupted = 1;
+}
+
+static double now_s() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void write_gap(trace_writer_t &out, uint32_t blocks) {
+	uint16_t gap[STREAM_BLOCK_SAMPLES];
+	
+	for(int i = 0; i < STREAM_BLOCK_SAMPLES; i++)
+		gap[i] = TRACE_GAP;
+	
+	for(uint32_t i = 0; i < blocks; i++)
+		trace_write(out, gap, STREAM_BLOCK_PAIRS);
+}
+
+static void handle_frame(const char *out_path, trace_writer_t &out, stats_t &st,
+		const uint8_t *frame, size_t len) {
+	
+	uint8_t record[PROTO_RECORD_MAX];
+	int n = proto_decode(frame, len, record);
+	
+	if(n < (int) sizeof(proto_header_t)) {
+		st.corrupt++;
+		return;
+	}
+	
+	st.frames++;
+	
+	if(record[0] != PROTO_STREAM || n < (int) offsetof(proto_stream_t, data))
+		return;
+	
+	if(n > (int) sizeof(proto_stream_t)) {
+		st.corrupt++;
+		return;
+	}
+	
+	proto_stream_t rec;
+	uint16_t samples[STREAM_BLOCK_SAMPLES];
+	
+	memcpy(&rec, record, n);
+	
+	if(!stream_decode(rec.data, n - offsetof(proto_stream_t, data),
+			samples, STREAM_BLOCK_SAMPLES)) {
+		st.corrupt++;
+		return;
+	}
+	
+	if(!st.started) {
+		if(!trace_create(out, out_path, rec.period_ps, rec.distance_um))
+			exit(1);
+		
+		st.started = true;
+		st.next_block = rec.block;
+	}
+	
+	if(rec.block < st.next_block)
+		return;
+	
+	if(rec.block > st.next_block) {
+		uint32_t gap = rec.block - st.next_block;
+		
+		fprintf(stderr, "block %u: %u block(s) dropped\n", rec.block, gap);
+		write_gap(out, gap);
+		st.gaps += gap;
+	}
+	
+	trace_write(out, samples, STREAM_BLOCK_PAIRS);
+	
+	st.blocks++;
+	st.next_block = rec.block + 1;
+	st.dropped = rec.dropped;
+}
+
+// Raw mode. Returns false if not a tty.
+static bool tty_raw(int fd) {
+	struct termios tio;
+	
+	if(tcgetattr(fd, &tio) != 0)
+		return false;
+	
+	cfmakeraw(&tio);
+	tcsetattr(fd, TCSANOW, &tio);
+	tcflush(fd, TCIOFLUSH);
+	
+	return true;
+}
+
+static void send_line(int fd, const char *line) {
+	if(write(fd, line, strlen(line)) < 0)
+		perror("write");
+}
+
+static int usage(const char *name) {
+	fprintf(stderr, "Usage: %s [-t seconds] -o out.trace [input]\n", name);
+	return 2;
+}
+
+int main(int argc, char *argv[]) {
+	const char *out_path = NULL;
+	double seconds = 0;
+	int fd = 0, opt;
+	
+	while((opt = getopt(argc, argv, "t:o:")) != -1) {
+		switch(opt) {
+			case 't': seconds = atof(optarg); break;
+			case 'o': out_path = optarg; break;
+			
+			default: return usage(argv[0]);
+		}
+	}
+	
+	if(!out_path)
+		return usage(argv[0]);
+	
+	if(optind < argc && (fd = open(argv[optind], O_RDWR | O_NOCTTY)) < 0
+			&& (fd = open(argv[optind], O_RDONLY)) < 0) {
+		perror(argv[optind]);
+		return 1;
+	}
+	
+	static trace_writer_t out;
+	
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+	
+	bool tty = tty_raw(fd);
+	
+	if(tty)
+		send_line(fd, "stream\n");
+	
+	stats_t st = {};
+	double end = now_s() + seconds;
+	
+	uint8_t frame[PROTO_FRAME_MAX];
+	size_t len = 0;
+	bool overflow = false;
+	
+	uint8_t buf[4096];
+	
+	while(!interrupted && (seconds == 0 || now_s() < end)) {
+		struct pollfd pfd = {.fd = fd, .events = POLLIN};
+		
+		if(poll(&pfd, 1, 100) <= 0)
+			continue;
+		
+		ssize_t n = read(fd, buf, sizeof(buf));
+		
+		if(n <= 0)
+			break;
+		
+		for(ssize_t i = 0; i < n; i++) {
+			if(buf[i] != 0) {
+				if(len < sizeof(frame))
+					frame[len++] = buf[i];
+				else
+					overflow = true;
+				
+				continue;
+			}
+			
+			if(overflow)
+				st.corrupt++;
+			else if(len)
+				handle_frame(out_path, out, st, frame, len);
+			
+			len = 0;
+			overflow = false;
+		}
+	}
+	
+	if(tty)
+		send_line(fd, "stop\n");
+	
+	if(st.started && !trace_finish(out)) {
+		perror(out_path);
+		return 1;
+	}
+	
+	fprintf(stderr, "%u blocks, %u gap(s) (%u dropped by the firmware), "
+		"%u frames, %u corrupt\n", st.blocks, st.gaps, st.dropped,
+		st.frames, st.corrupt);
+	
+	return (st.started ? 0 : 1);
+}
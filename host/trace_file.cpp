@@ -0,0 +1,294 @@
+/**
+ * Trace file reader and writer, see trace.h.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "trace_file.h"
+#include "../chronograph.h"
+
+// -------------------------------------------------
+
+static bool fail(const char *path, const char *reason) {
+	fprintf(stderr, "%s: %s\n", path, reason);
+	return false;
+}
+
+// Chunk offsets, by their lengths, up to the first incomplete one
+static void recover_chunks(trace_file_t &t) {
+	uint64_t offset = sizeof(trace_header_t);
+	
+	t.recovered.push_back(offset);
+	
+	while(offset + sizeof(trace_chunk_t) <= t.size) {
+		trace_chunk_t chunk;
+		memcpy(&chunk, t.data + offset, sizeof(chunk));
+		
+		uint64_t end = offset + sizeof(chunk) + chunk.bytes;
+		
+		if(chunk.pairs == 0 || chunk.pairs > TRACE_CHUNK_PAIRS
+				|| chunk.bytes > TRACE_CHUNK_DATA_MAX || end > t.size)
+			break;
+		
+		offset = end;
+		t.recovered.push_back(offset);
+		t.num_pairs += chunk.pairs;
+	}
+	
+	t.num_chunks = t.recovered.size() - 1;
+	t.chunks = t.recovered.data();
+}
+
+bool trace_open(trace_file_t &t, const char *path) {
+	int fd = open(path, O_RDONLY);
+	struct stat st;
+	
+	t = trace_file_t();
+	
+	if(fd < 0 || fstat(fd, &st) != 0) {
+		if(fd >= 0)
+			close(fd);
+		
+		return fail(path, strerror(errno));
+	}
+	
+	if((size_t) st.st_size < sizeof(trace_header_t)) {
+		close(fd);
+		return fail(path, "not a trace");
+	}
+	
+	void *data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	
+	if(data == MAP_FAILED)
+		return fail(path, strerror(errno));
+	
+	t.data = (const uint8_t *) data;
+	t.size = st.st_size;
+	t.header = (const trace_header_t *) data;
+	
+	const trace_header_t &h = *t.header;
+	
+	if(h.magic != TRACE_MAGIC || h.channels != STREAM_CHANNELS || h.period_ps == 0) {
+		trace_close(t);
+		return fail(path, "not a trace");
+	}
+	
+	if(h.version != TRACE_VERSION || h.chunk_pairs != TRACE_CHUNK_PAIRS) {
+		trace_close(t);
+		return fail(path, "unsupported trace version");
+	}
+	
+	uint64_t index_size = (h.num_chunks + 1) * sizeof(uint64_t)
+		+ (uint64_t) h.num_shots * sizeof(trace_shot_t);
+	
+	if(h.index_offset == 0) {
+		recover_chunks(t);
+		fprintf(stderr, "%s: no index, %lu chunk(s) recovered\n",
+			path, (unsigned long) t.num_chunks);
+		
+		return true;
+	}
+	
+	if(h.index_offset > t.size || t.size - h.index_offset < index_size
+			|| h.num_chunks * TRACE_CHUNK_PAIRS < h.num_pairs) {
+		trace_close(t);
+		return fail(path, "bad index");
+	}
+	
+	t.num_chunks = h.num_chunks;
+	t.num_pairs = h.num_pairs;
+	t.chunks = (const uint64_t *) (t.data + h.index_offset);
+	t.shots = (const trace_shot_t *) (t.chunks + h.num_chunks + 1);
+	t.num_shots = h.num_shots;
+	
+	return true;
+}
+
+void trace_close(trace_file_t &t) {
+	if(t.data)
+		munmap((void *) t.data, t.size);
+	
+	t = trace_file_t();
+}
+
+uint32_t trace_read_chunk(const trace_file_t &t, uint64_t k, uint16_t *samples) {
+	if(k >= t.num_chunks)
+		return 0;
+	
+	uint64_t offset = t.chunks[k];
+	trace_chunk_t chunk;
+	
+	if(offset > t.chunks[k + 1] || t.chunks[k + 1] > t.size
+			|| t.chunks[k + 1] - offset < sizeof(chunk))
+		return 0;
+	
+	memcpy(&chunk, t.data + offset, sizeof(chunk));
+	
+	if(chunk.pairs > TRACE_CHUNK_PAIRS
+			|| sizeof(chunk) + chunk.bytes != t.chunks[k + 1] - offset)
+		return 0;
+	
+	const uint8_t *src = t.data + offset + sizeof(chunk);
+	
+	if(!stream_decode(src, chunk.bytes, samples, chunk.pairs * STREAM_CHANNELS))
+		return 0;
+	
+	return chunk.pairs;
+}
+
+bool trace_read(const trace_file_t &t, uint64_t first, uint64_t count, uint16_t *samples) {
+	static uint16_t chunk[TRACE_CHUNK_SAMPLES];
+	
+	if(first > t.num_pairs || count > t.num_pairs - first)
+		return false;
+	
+	while(count) {
+		uint64_t k = first / TRACE_CHUNK_PAIRS;
+		uint32_t skip = first % TRACE_CHUNK_PAIRS;
+		uint32_t pairs = trace_read_chunk(t, k, chunk);
+		
+		if(pairs <= skip)
+			return false;
+		
+		uint64_t n = pairs - skip;
+		
+		if(n > count)
+			n = count;
+		
+		memcpy(samples, chunk + skip * STREAM_CHANNELS, n * STREAM_CHANNELS * 2);
+		
+		samples += n * STREAM_CHANNELS;
+		first += n;
+		count -= n;
+	}
+	
+	return true;
+}
+
+// -------------------------------------------------
+
+static void write_chunk(trace_writer_t &w) {
+	static uint8_t data[TRACE_CHUNK_DATA_MAX];
+	
+	trace_chunk_t chunk = {
+		.pairs = w.buffered,
+		.bytes = (uint32_t) stream_encode(w.buf, w.buffered * STREAM_CHANNELS, data)
+	};
+	
+	fwrite(&chunk, sizeof(chunk), 1, w.f);
+	fwrite(data, chunk.bytes, 1, w.f);
+	
+	w.chunks.push_back(w.offset);
+	w.offset += sizeof(chunk) + chunk.bytes;
+	
+	w.header.num_pairs += w.buffered;
+	w.buffered = 0;
+}
+
+bool trace_create(trace_writer_t &w, const char *path,
+		uint32_t period_ps, uint32_t distance_um) {
+	
+	w.f = fopen(path, "wb");
+	
+	if(!w.f) {
+		perror(path);
+		return false;
+	}
+	
+	w.header = (trace_header_t) {
+		.magic = TRACE_MAGIC,
+		.version = TRACE_VERSION,
+		.channels = STREAM_CHANNELS,
+		.period_ps = period_ps,
+		.distance_um = distance_um,
+		.channel_map = {CHANNEL_FRONT, CHANNEL_REAR},
+		.chunk_pairs = TRACE_CHUNK_PAIRS
+	};
+	
+	w.chunks.clear();
+	w.offset = sizeof(w.header);
+	w.buffered = 0;
+	
+	// Without an index, until finished
+	fwrite(&w.header, sizeof(w.header), 1, w.f);
+	
+	return true;
+}
+
+void trace_write(trace_writer_t &w, const uint16_t *samples, uint32_t pairs) {
+	while(pairs) {
+		uint32_t n = TRACE_CHUNK_PAIRS - w.buffered;
+		
+		if(n > pairs)
+			n = pairs;
+		
+		memcpy(w.buf + w.buffered * STREAM_CHANNELS, samples, n * STREAM_CHANNELS * 2);
+		
+		w.buffered += n;
+		samples += n * STREAM_CHANNELS;
+		pairs -= n;
+		
+		if(w.buffered == TRACE_CHUNK_PAIRS)
+			write_chunk(w);
+	}
+}
+
+bool trace_finish(trace_writer_t &w) {
+	if(w.buffered)
+		write_chunk(w);
+	
+	w.chunks.push_back(w.offset);
+	
+	w.header.num_chunks = w.chunks.size() - 1;
+	w.header.index_offset = w.offset;
+	w.header.num_shots = 0;
+	
+	fwrite(w.chunks.data(), sizeof(uint64_t), w.chunks.size(), w.f);
+	
+	bool ok = (fseek(w.f, 0, SEEK_SET) == 0
+		&& fwrite(&w.header, sizeof(w.header), 1, w.f) == 1);
+	
+	if(fclose(w.f) != 0)
+		ok = false;
+	
+	w.f = NULL;
+	return ok;
+}
+
+bool trace_write_shots(const char *path, const trace_shot_t *shots, uint32_t num_shots) {
+	FILE *f = fopen(path, "r+b");
+	trace_header_t header;
+	
+	if(!f) {
+		perror(path);
+		return false;
+	}
+	
+	if(fread(&header, sizeof(header), 1, f) != 1 || header.magic != TRACE_MAGIC
+			|| header.version != TRACE_VERSION || header.index_offset == 0) {
+		fclose(f);
+		return fail(path, "not a complete trace");
+	}
+	
+	// The chunk offsets stay, the shots follow
+	long shots_offset = header.index_offset + (header.num_chunks + 1) * sizeof(uint64_t);
+	header.num_shots = num_shots;
+	
+	bool ok = (fseek(f, shots_offset, SEEK_SET) == 0
+		&& fwrite(shots, sizeof(*shots), num_shots, f) == num_shots
+		&& ftruncate(fileno(f), ftell(f)) == 0
+		&& fseek(f, 0, SEEK_SET) == 0
+		&& fwrite(&header, sizeof(header), 1, f) == 1);
+	
+	if(fclose(f) != 0 || !ok)
+		return fail(path, "failed to write the index");
+	
+	return true;
+}
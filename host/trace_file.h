@@ -0,0 +1,72 @@
+#ifndef TRACE_FILE_H
+#define TRACE_FILE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include <vector>
+
+#include "../trace.h"
+
+/* Trace files (see trace.h), memory-mapped for reading. Opening
+ * only checks the header and locates the index, so it takes the
+ * same time for any size, and only the chunks that are read are
+ * paged in. */
+
+typedef struct {
+	const uint8_t *data;
+	size_t size;
+	
+	const trace_header_t *header;
+	uint64_t num_pairs;
+	uint64_t num_chunks;
+	
+	// Chunk offsets, num_chunks + 1
+	const uint64_t *chunks;
+	
+	const trace_shot_t *shots;
+	uint32_t num_shots;
+	
+	// Without an index, found by walking the chunks
+	std::vector<uint64_t> recovered;
+} trace_file_t;
+
+// Prints the reason on stderr, if it fails
+bool trace_open(trace_file_t &t, const char *path);
+void trace_close(trace_file_t &t);
+
+/* Decode chunk k into samples (TRACE_CHUNK_SAMPLES). Returns
+ * its sample pairs, 0 if corrupt. */
+uint32_t trace_read_chunk(const trace_file_t &t, uint64_t k, uint16_t *samples);
+
+/* Decode pairs [first, first + count), within the trace, into
+ * samples. Only the chunks holding them are decoded. */
+bool trace_read(const trace_file_t &t, uint64_t first, uint64_t count, uint16_t *samples);
+
+// -------------------------------------------------
+
+// Written in order, samples are buffered into chunks
+typedef struct {
+	FILE *f;
+	trace_header_t header;
+	
+	std::vector<uint64_t> chunks;
+	uint64_t offset;
+	
+	uint16_t buf[TRACE_CHUNK_SAMPLES];
+	uint32_t buffered;
+} trace_writer_t;
+
+bool trace_create(trace_writer_t &w, const char *path,
+	uint32_t period_ps, uint32_t distance_um);
+
+void trace_write(trace_writer_t &w, const uint16_t *samples, uint32_t pairs);
+
+// Writes the last chunk, an empty shot index and the header
+bool trace_finish(trace_writer_t &w);
+
+// Replace the shot index of a complete trace
+bool trace_write_shots(const char *path, const trace_shot_t *shots, uint32_t num_shots);
+
+#endif
@@ -0,0 +1,141 @@
+/**
+ * Trace file viewer.
+ *
+ * Prints a trace's header and shot index (see trace.h), or writes
+ * samples as CSV: those around a shot of the index (-s), or a range
+ * of sample pairs (-p, -n). Only the chunks holding them are read.
+ * Gaps are empty fields.
+ *
+ * Usage: tracecat [-s shot] [-w pairs] [-p first] [-n count] trace
+ *   -w  pairs before the front trigger and after the rear one (256)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "trace_file.h"
+
+// -------------------------------------------------
+
+static void print_info(const trace_file_t &t) {
+	const trace_header_t &h = *t.header;
+	
+	printf("version %u, %u channels (ADC %u, %u), %.3f us period, "
+		"distance %u um\n", h.version, h.channels, h.channel_map[0],
+		h.channel_map[1], h.period_ps * 1e-6, h.distance_um);
+	
+	printf("%lu pairs (%.3f s), %lu chunks, %zu bytes\n",
+		(unsigned long) t.num_pairs, t.num_pairs * h.period_ps * 1e-12,
+		(unsigned long) t.num_chunks, t.size);
+	
+	if(!t.shots) {
+		printf("no shot index\n");
+		return;
+	}
+	
+	printf("%u shots\n", t.num_shots);
+	
+	if(!t.num_shots)
+		return;
+	
+	printf("shot,front_pair,rear_pair,time_s,ticks,dt_us,speed\n");
+	
+	for(uint32_t i = 0; i < t.num_shots; i++) {
+		const trace_shot_t &s = t.shots[i];
+		
+		printf("%u,%lu,%lu,%.6f,%u,%.3f,%.3f\n", i,
+			(unsigned long) s.front_pair, (unsigned long) s.rear_pair,
+			s.front_pair * h.period_ps * 1e-12, s.ticks,
+			(double) s.ticks * 1e6 / s.timer_freq, s.speed);
+	}
+}
+
+static bool print_samples(const trace_file_t &t, uint64_t first, uint64_t count) {
+	if(first >= t.num_pairs)
+		return false;
+	
+	if(count > t.num_pairs - first)
+		count = t.num_pairs - first;
+	
+	std::vector<uint16_t> samples(count * STREAM_CHANNELS);
+	
+	if(!trace_read(t, first, count, samples.data()))
+		return false;
+	
+	printf("pair,time_us,front,rear\n");
+	
+	for(uint64_t i = 0; i < count; i++) {
+		printf("%lu,%.3f", (unsigned long) (first + i),
+			(first + i) * t.header->period_ps * 1e-6);
+		
+		for(int ch = 0; ch < STREAM_CHANNELS; ch++) {
+			uint16_t value = samples[i * STREAM_CHANNELS + ch];
+			
+			if(value == TRACE_GAP)
+				printf(",");
+			else
+				printf(",%u", value);
+		}
+		
+		printf("\n");
+	}
+	
+	return true;
+}
+
+static int usage(const char *name) {
+	fprintf(stderr, "Usage: %s [-s shot] [-w pairs] [-p first] [-n count] trace\n", name);
+	return 2;
+}
+
+int main(int argc, char *argv[]) {
+	long shot = -1;
+	uint64_t window = 256, first = 0, count = 0;
+	int opt;
+	
+	while((opt = getopt(argc, argv, "s:w:p:n:")) != -1) {
+		switch(opt) {
+			case 's': shot = atol(optarg); break;
+			case 'w': window = strtoull(optarg, NULL, 10); break;
+			case 'p': first = strtoull(optarg, NULL, 10); break;
+			case 'n': count = strtoull(optarg, NULL, 10); break;
+			
+			default: return usage(argv[0]);
+		}
+	}
+	
+	if(optind != argc - 1)
+		return usage(argv[0]);
+	
+	trace_file_t t;
+	
+	if(!trace_open(t, argv[optind]))
+		return 1;
+	
+	if(shot >= 0) {
+		if(shot >= t.num_shots) {
+			fprintf(stderr, "no shot %ld, %u indexed\n", shot, t.num_shots);
+			return 1;
+		}
+		
+		const trace_shot_t &s = t.shots[shot];
+		
+		first = (s.front_pair > window ? s.front_pair - window : 0);
+		count = s.rear_pair + window + 1 - first;
+	}
+	
+	if(!count) {
+		print_info(t);
+		return 0;
+	}
+	
+	if(!print_samples(t, first, count)) {
+		fprintf(stderr, "%s: corrupt, or out of range\n", argv[optind]);
+		return 1;
+	}
+	
+	return 0;
+}
@@ -0,0 +1,110 @@
+#ifndef WAVEFORM_H
+#define WAVEFORM_H
+
+#include <stdint.h>
+#include <math.h>
+
+/* Synthetic photodiode signals, for the simulator and the benchmark.
+ *
+ * A series of shots, one every interval, at a fixed speed. Each gate
+ * is a beam of the aperture's width, and its signal rises with the
+ * part of the beam the BB covers: a trapezoid, lasting
+ * (diameter + aperture) / speed, flat while one of them covers the
+ * other. The rear gate sees the same pulse, distance / speed later.
+ *
+ * The baseline drifts (ambient light) as a slow sine, and both
+ * channels get independent Gaussian noise. The noise is a hash of
+ * the time, so a signal only depends on its parameters. */
+
+typedef struct {
+	double speed_mps;
+	double diameter_mm;
+	double aperture_mm;
+	uint32_t distance_um;
+	
+	// ADC counts: the baseline, the pulse at full cover, noise RMS
+	double baseline;
+	double amplitude;
+	double noise_rms;
+	
+	// Baseline drift, amplitude (ADC counts) and period
+	double drift;
+	double drift_period_s;
+	
+	uint32_t shots;
+	uint32_t interval_ms;
+	uint32_t seed;
+} wave_t;
+
+// -------------------------------------------------
+
+// Front pulse center of shot k, 1 to shots
+inline uint64_t wave_front_ns(const wave_t &w, uint32_t k) {
+	return (uint64_t) k * w.interval_ms * 1000000;
+}
+
+inline uint64_t wave_flight_ns(const wave_t &w) {
+	return w.distance_um * 1000.0 / w.speed_mps;
+}
+
+// Ends once the last shot has been followed by an interval
+inline uint64_t wave_end_ns(const wave_t &w) {
+	return wave_front_ns(w, w.shots + 1);
+}
+
+// Uniform in (0, 1)
+inline double wave_uniform(uint64_t x) {
+	x ^= x >> 33;
+	x *= 0xFF51AFD7ED558CCDull;
+	x ^= x >> 33;
+	x *= 0xC4CEB9FE1A85EC53ull;
+	x ^= x >> 33;
+	
+	return ((x >> 11) + 0.5) / 9007199254740992.0;
+}
+
+// Box-Muller
+inline double wave_gauss(const wave_t &w, uint8_t channel, uint64_t time_ns) {
+	uint64_t key = (time_ns * 2 + channel) * 2 + ((uint64_t) w.seed << 48);
+	
+	double u1 = wave_uniform(key);
+	double u2 = wave_uniform(key + 1);
+	
+	return sqrt(-2 * log(u1)) * cos(2 * M_PI * u2);
+}
+
+// Part of the beam covered, with the BB's center x_mm from the beam's
+inline double wave_cover(const wave_t &w, double x_mm) {
+	double lo = fmax(x_mm - w.diameter_mm / 2, -w.aperture_mm / 2);
+	double hi = fmin(x_mm + w.diameter_mm / 2, w.aperture_mm / 2);
+	
+	if(hi <= lo)
+		return 0;
+	
+	return (hi - lo) / fmin(w.diameter_mm, w.aperture_mm);
+}
+
+// Channel 0 is the front gate, 1 the rear
+inline uint16_t wave_sample(const wave_t &w, uint8_t channel, uint64_t time_ns) {
+	double value = w.baseline + w.noise_rms * wave_gauss(w, channel, time_ns);
+	
+	if(w.drift)
+		value += w.drift * sin(2 * M_PI * time_ns * 1e-9 / w.drift_period_s);
+	
+	// The nearest shot
+	uint64_t interval_ns = (uint64_t) w.interval_ms * 1000000;
+	uint64_t k = (time_ns + interval_ns / 2) / interval_ns;
+	
+	if(k >= 1 && k <= w.shots) {
+		uint64_t center_ns = wave_front_ns(w, k) + (channel ? wave_flight_ns(w) : 0);
+		
+		// m/s = 10^-6 mm/ns
+		double x_mm = ((double) time_ns - center_ns) * w.speed_mps * 1e-6;
+		
+		value += w.amplitude * wave_cover(w, x_mm);
+	}
+	
+	return (value < 0 ? 0 : value > 4095 ? 4095 : (uint16_t) lround(value));
+}
+
+#endif
@@ -0,0 +1,74 @@
+#include <core/usb_vcp.h>
+
+#include "log.h"
+#include "protocol.h"
+#include "chronograph.h"
+
+// --------------------------------------------
+
+log_ring_t log_ring;
+
+// --------------------------------------------
+
+static uint16_t entry_words(uint16_t pos) {
+	return 2 + LOG_HEADER_NARGS(log_ring.words[pos]);
+}
+
+static uint32_t ring_word(uint16_t pos) {
+	return log_ring.words[pos & (LOG_WORDS - 1)];
+}
+
+static void send_record() {
+	proto_log_t record = {.header = {.type = PROTO_LOG}};
+	uint8_t n = 0;
+	
+	record.dropped = log_ring.dropped;
+	log_ring.dropped = 0;
+	
+	while(log_ring.tail != log_ring.head) {
+		uint16_t len = entry_words(log_ring.tail);
+		
+		if(n + len > PROTO_LOG_WORDS)
+			break;
+		
+		for(uint16_t i = 0; i < len; i++)
+			record.words[n++] = ring_word(log_ring.tail + i);
+		
+		log_ring.tail = (log_ring.tail + len) & (LOG_WORDS - 1);
+	}
+	
+	proto_send(record.header, sizeof(record) - sizeof(record.words) + n * 4);
+}
+
+static void print_entry() {
+	if(log_ring.dropped) {
+		vcp_printf("log: %u dropped\n", log_ring.dropped);
+		log_ring.dropped = 0;
+	}
+	
+	if(log_ring.tail == log_ring.head)
+		return;
+	
+	uint32_t header = ring_word(log_ring.tail);
+	uint32_t args[LOG_ARGS_MAX] = {};
+	
+	for(uint8_t i = 0; i < LOG_HEADER_NARGS(header) && i < LOG_ARGS_MAX; i++)
+		args[i] = ring_word(log_ring.tail + 2 + i);
+	
+	vcp_printf("[%u] ", ring_word(log_ring.tail + 1));
+	vcp_printf(log_format(LOG_HEADER_ID(header)), args[0], args[1], args[2]);
+	vcp_printf("\n");
+	
+	log_ring.tail = (log_ring.tail + entry_words(log_ring.tail)) & (LOG_WORDS - 1);
+}
+
+void log_service(uint8_t output) {
+	if(output == log_binary)
+		send_record();
+	else if(output == log_text)
+		print_entry();
+	else {
+		log_ring.tail = log_ring.head;
+		log_ring.dropped = 0;
+	}
+}
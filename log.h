@@ -0,0 +1,132 @@
+/**
+ * Deferred logging.
+ *
+ * A log site only stores a message ID, a timestamp and its raw
+ * arguments in a RAM ring, which takes a few cycles, so logging
+ * is always on, even in the sample loop. Formatting is deferred:
+ * between shots, log_service() drains the ring, as set by the `log`
+ * setting (chrono_log_t):
+ *   off     discarded, the default, so the output only has shots
+ *   binary  PROTO_LOG records, that host/shotdec formats
+ *   text    formatted by the firmware, for a terminal
+ *
+ * The messages are listed in LOG_MESSAGES, shared with the host.
+ * Arguments are 32-bit words, formatted with %u, %d or %x.
+ *
+ * The ring is written and drained by the main loop only, so log
+ * sites must not be in ISRs.
+ */
+
+#ifndef LOG_H
+#define LOG_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <core/millis.h>
+
+// -------------------------------------------------
+
+// X(id, format)
+#define LOG_MESSAGES(X) \
+	X(LOG_FRONT, "front trigger, peak %u") \
+	X(LOG_TIMEOUT, "timeout, %u since the last shot") \
+	X(LOG_ZERO_TICKS, "zero ticks between triggers") \
+	X(LOG_CMD_APPLY, "command actions 0x%x") \
+	X(LOG_SUSPECT, "suspect shot, %u ticks")
+
+#define LOG_ID(id, format) id,
+typedef enum {LOG_MESSAGES(LOG_ID) LOG_NUM_MESSAGES} log_id_t;
+#undef LOG_ID
+
+// Most arguments of a message
+#define LOG_ARGS_MAX 3
+
+// Ring size, in words. Power of 2.
+#define LOG_WORDS 256
+
+/* An entry is a header word, (id | nargs << 8), the millis()
+ * timestamp, and the arguments. */
+#define LOG_HEADER(id, nargs) ((uint32_t) (id) | (uint32_t) (nargs) << 8)
+#define LOG_HEADER_ID(header) ((header) & 0xFF)
+#define LOG_HEADER_NARGS(header) (((header) >> 8) & 0xFF)
+
+typedef struct {
+	uint32_t words[LOG_WORDS];
+	uint16_t head, tail;
+	
+	// Entries that didn't fit, since the last drain
+	uint16_t dropped;
+} log_ring_t;
+
+extern log_ring_t log_ring;
+
+// -------------------------------------------------
+
+inline void log_word(uint32_t word) {
+	log_ring.words[log_ring.head] = word;
+	log_ring.head = (log_ring.head + 1) & (LOG_WORDS - 1);
+}
+
+// Starts an entry, or drops it if the ring is full
+inline bool log_begin(log_id_t id, uint8_t nargs) {
+	uint16_t used = (log_ring.head - log_ring.tail) & (LOG_WORDS - 1);
+	
+	if(used + 2 + nargs >= LOG_WORDS) {
+		log_ring.dropped++;
+		return false;
+	}
+	
+	log_word(LOG_HEADER(id, nargs));
+	log_word(millis());
+	
+	return true;
+}
+
+inline void log_write(log_id_t id) {
+	log_begin(id, 0);
+}
+
+inline void log_write(log_id_t id, uint32_t a) {
+	if(log_begin(id, 1))
+		log_word(a);
+}
+
+inline void log_write(log_id_t id, uint32_t a, uint32_t b) {
+	if(log_begin(id, 2)) {
+		log_word(a);
+		log_word(b);
+	}
+}
+
+inline void log_write(log_id_t id, uint32_t a, uint32_t b, uint32_t c) {
+	if(log_begin(id, 3)) {
+		log_word(a);
+		log_word(b);
+		log_word(c);
+	}
+}
+
+#define LOG(...) log_write(__VA_ARGS__)
+
+inline bool log_pending() {
+	return log_ring.head != log_ring.tail || log_ring.dropped;
+}
+
+// -------------------------------------------------
+
+// Format string of a message, or NULL if unknown
+inline const char *log_format(uint8_t id) {
+	#define LOG_FORMAT(id, format) format,
+	static const char *const formats[] = {LOG_MESSAGES(LOG_FORMAT)};
+	#undef LOG_FORMAT
+	
+	return (id < LOG_NUM_MESSAGES ? formats[id] : NULL);
+}
+
+/* Firmware only, see log.cpp. Drains part of the ring, for a
+ * chrono_log_t: one PROTO_LOG record, one formatted message, or
+ * all of it, unsent. */
+void log_service(uint8_t output);
+
+#endif
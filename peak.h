@@ -28,6 +28,9 @@
  *   RCC_CFGR_ADCPRE_PCLK2_DIV2
  *   ADC_SMPR_SMP_1DOT5CYC
  * 
+ * With make PROFILE=1, peak_detect() is timed in place by
+ * the PROF_PEAK scope, see profile.h and the `prof` command.
+ * 
  */
 
 #ifndef PEAK_H
@@ -35,8 +38,6 @@
 
 #include <stdint.h>
 
-#include <core/usb_vcp.h>
-
 typedef unsigned int uint;
 typedef unsigned long ulong;
 
@@ -50,6 +51,9 @@ typedef struct {
 	
 	uint16_t *samples;
 	ulong sample_sum;
+	
+	// Height of the last peak, over the average before it
+	uint16_t peak;
 } peak_stat_t;
 
 inline void peak_stat_init(peak_stat_t &s, uint threshold,
@@ -64,7 +68,9 @@ inline void peak_stat_init(peak_stat_t &s, uint threshold,
 		.oldest = 0,
 		
 		.samples = samples,
-		.sample_sum = 0
+		.sample_sum = 0,
+		
+		.peak = 0
 	};
 }
 
@@ -85,6 +91,7 @@ inline bool peak_detect(peak_stat_t &s, uint16_t value) {
 			uint16_t previous = s.samples[(s.oldest + s.lag - 1) % s.lag];
 			new_value = s.influence * value + (1 - s.influence) * previous;
 			
+			s.peak = value - average;
 			has_peak = true;
 		}
 		
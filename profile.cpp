@@ -0,0 +1,67 @@
+#include "profile.h"
+#include "format.h"
+
+#if defined(PROFILE)
+
+// --------------------------------------------
+
+prof_hist_t prof_hists[PROF_NUM_STAGES];
+uint32_t prof_starts[PROF_NUM_STAGES];
+
+// --------------------------------------------
+
+void prof_reset() {
+	for(int i = 0; i < PROF_NUM_STAGES; i++)
+		prof_hists[i] = {};
+}
+
+/* Per stage, a summary line, and a line per non-empty bin,
+ * with its lower bound:
+ *
+ *   peak n=1000 min=40 avg=41 max=97 cycles
+ *    32: 998
+ *    64: 2 */
+void prof_print(void (*out)(const char *str)) {
+	#define PROF_NAME(id, name) name,
+	static const char *const names[] = {PROF_STAGES(PROF_NAME)};
+	#undef PROF_NAME
+	
+	char buffer[24];
+	
+	for(int i = 0; i < PROF_NUM_STAGES; i++) {
+		const prof_hist_t &h = prof_hists[i];
+		
+		out(names[i]);
+		
+		fmt_uint(fmt_str(buffer, " n="), h.count);
+		out(buffer);
+		
+		if(h.count == 0) {
+			out("\n");
+			continue;
+		}
+		
+		fmt_uint(fmt_str(buffer, " min="), h.min);
+		out(buffer);
+		
+		fmt_uint(fmt_str(buffer, " avg="), h.sum / h.count);
+		out(buffer);
+		
+		fmt_uint(fmt_str(buffer, " max="), h.max);
+		out(buffer);
+		
+		out(" " PROF_UNIT "\n");
+		
+		for(int b = 0; b < PROF_BINS; b++) {
+			if(!h.bins[b])
+				continue;
+			
+			char *end = fmt_uint(buffer, b ? 1u << b : 0, 9);
+			fmt_str(fmt_uint(fmt_str(end, ": "), h.bins[b]), "\n");
+			
+			out(buffer);
+		}
+	}
+}
+
+#endif
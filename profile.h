@@ -0,0 +1,114 @@
+/**
+ * Profiling scopes.
+ *
+ * Built with PROFILE (make PROFILE=1), the stages in PROF_STAGES
+ * are timed, and each stage's durations are kept in a histogram of
+ * power of 2 bins, printed by the `prof` command. The clock is the
+ * DWT cycle counter on the target (cycles, at 72 MHz), and
+ * std::chrono on the host (ns). Not hal_cycles(), which follows
+ * the simulated clock there.
+ *
+ * Without PROFILE, PROF_START() and PROF_STOP() expand to nothing,
+ * and `prof` only replies with an error.
+ *
+ * A stage's start is kept in prof_starts, so a scope may end in
+ * another function, or an ISR (the display transfers). Scopes of the
+ * same stage must not nest, others may: format (the fmt_*() calls,
+ * see format.h) is also part of draw and report.
+ */
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdint.h>
+
+#if defined(PROFILE) && defined(CHRONO_HOST)
+	#include <chrono>
+#elif defined(PROFILE)
+	#include <libopencm3/cm3/dwt.h>
+#endif
+
+// -------------------------------------------------
+
+// X(id, name)
+#define PROF_STAGES(X) \
+	X(PROF_ADC, "adc") \
+	X(PROF_PEAK, "peak") \
+	X(PROF_CALC, "calc") \
+	X(PROF_REPORT, "report") \
+	X(PROF_FORMAT, "format") \
+	X(PROF_DRAW, "draw") \
+	X(PROF_XFER, "xfer")
+
+#define PROF_ID(id, name) id,
+typedef enum {PROF_STAGES(PROF_ID) PROF_NUM_STAGES} prof_id_t;
+#undef PROF_ID
+
+/* Bin i holds durations of [2^i, 2^(i+1)) ticks, bin 0 also 0.
+ * The last one holds everything above. */
+#define PROF_BINS 24
+
+typedef struct {
+	uint32_t bins[PROF_BINS];
+	
+	uint32_t count;
+	uint32_t min, max;
+	uint64_t sum;
+} prof_hist_t;
+
+#if defined(PROFILE)
+
+#if defined(CHRONO_HOST)
+	#define PROF_UNIT "ns"
+#else
+	#define PROF_UNIT "cycles"
+#endif
+
+extern prof_hist_t prof_hists[PROF_NUM_STAGES];
+extern uint32_t prof_starts[PROF_NUM_STAGES];
+
+inline void prof_init() {
+	#if !defined(CHRONO_HOST)
+		dwt_enable_cycle_counter();
+	#endif
+}
+
+inline uint32_t prof_now() {
+	#if defined(CHRONO_HOST)
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+	#else
+		return dwt_read_cycle_counter();
+	#endif
+}
+
+inline void prof_record(prof_id_t id, uint32_t ticks) {
+	prof_hist_t &h = prof_hists[id];
+	int bin = 31 - __builtin_clz(ticks | 1);
+	
+	h.bins[bin < PROF_BINS ? bin : PROF_BINS - 1]++;
+	
+	if(h.count == 0 || ticks < h.min) h.min = ticks;
+	if(ticks > h.max) h.max = ticks;
+	
+	h.count++;
+	h.sum += ticks;
+}
+
+// Print the histograms, see command.h
+void prof_print(void (*out)(const char *str));
+void prof_reset();
+
+#define PROF_INIT() prof_init()
+#define PROF_START(id) (prof_starts[id] = prof_now())
+#define PROF_STOP(id) prof_record(id, prof_now() - prof_starts[id])
+
+#else
+
+#define PROF_INIT() ((void) 0)
+#define PROF_START(id) ((void) 0)
+#define PROF_STOP(id) ((void) 0)
+
+#endif
+
+#endif
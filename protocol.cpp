@@ -0,0 +1,16 @@
+#include <core/usb_vcp.h>
+
+#include "protocol.h"
+
+// --------------------------------------------
+
+static uint16_t proto_seq;
+
+void proto_send(proto_header_t &record, size_t len) {
+	uint8_t frame[PROTO_FRAME_MAX];
+	
+	record.seq = proto_seq++;
+	
+	size_t n = proto_encode(&record, len, frame);
+	vcp_send(frame, n);
+}
@@ -0,0 +1,136 @@
+/**
+ * Binary record protocol over the VCP.
+ *
+ * Each frame is a record, followed by the CRC-32 of the record
+ * (see crc.h), COBS-encoded (see cobs.h) and delimited by a zero
+ * byte on each side, so that it doesn't depend on whatever was
+ * sent before it (e.g. text output). All fields are little-endian.
+ * The first byte of a record is its type, and every record carries
+ * a sequence number, so that receivers can tell when frames were
+ * lost.
+ *
+ * Frames are only sent in output_binary mode. Host-side, the
+ * inline functions here are the decoder; see host/shotdec.cpp.
+ */
+
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "cobs.h"
+#include "crc.h"
+
+// -------------------------------------------------
+
+// Record types
+#define PROTO_SHOT 0x01
+#define PROTO_LOG 0x02
+#define PROTO_STREAM 0x03
+#define PROTO_SNAP 0x04
+
+// Largest record (see stream.h), and the resulting frame (with the delimiters)
+#define PROTO_RECORD_MAX 276
+#define PROTO_FRAME_MAX (COBS_MAX_ENCODED(PROTO_RECORD_MAX + 4) + 2)
+
+// Common to all records
+typedef struct __attribute__((packed)) {
+	uint8_t type;
+	uint8_t reserved;
+	uint16_t seq;
+} proto_header_t;
+
+typedef struct __attribute__((packed)) {
+	proto_header_t header;
+	
+	// millis() at the rear trigger
+	uint32_t time_ms;
+	
+	// Timer ticks between the triggers, at TIMER_FREQ
+	uint16_t ticks;
+	
+	// ADC value above the moving average, at each trigger
+	uint16_t front_peak;
+	uint16_t rear_peak;
+	
+	// Front triggers that timed out since the last shot
+	uint16_t timeouts;
+	
+	uint32_t timer_freq;
+	uint32_t distance_um;
+	
+	// Calibrated speed, as used for the stats (m/s)
+	float speed;
+} proto_shot_t;
+
+static_assert(sizeof(proto_shot_t) <= PROTO_RECORD_MAX, "Record too large");
+
+// Log entries per record, in words, see log.h
+#define PROTO_LOG_WORDS ((PROTO_RECORD_MAX - 8) / 4)
+
+/* Whole log entries, as stored in the ring. Only the
+ * used words are sent, so the record's length varies. */
+typedef struct __attribute__((packed)) {
+	proto_header_t header;
+	
+	// Entries dropped, before these, as the ring was full
+	uint16_t dropped;
+	uint16_t reserved;
+	
+	uint32_t words[PROTO_LOG_WORDS];
+} proto_log_t;
+
+static_assert(sizeof(proto_log_t) <= PROTO_RECORD_MAX, "Record too large");
+
+// -------------------------------------------------
+
+/* Frame a record into dst (at least PROTO_FRAME_MAX bytes).
+ * Returns the frame's length, including the delimiters. */
+inline size_t proto_encode(const void *record, size_t len, uint8_t *dst) {
+	uint8_t buf[PROTO_RECORD_MAX + 4];
+	uint32_t crc = crc32(record, len);
+	
+	memcpy(buf, record, len);
+	memcpy(buf + len, &crc, 4);
+	
+	dst[0] = 0;
+	
+	size_t n = 1 + cobs_encode(buf, len + 4, dst + 1);
+	dst[n++] = 0;
+	
+	return n;
+}
+
+/* Decode a frame, without its delimiters, into record (at least
+ * PROTO_RECORD_MAX bytes). Returns the record's length, or -1
+ * if the frame is malformed or fails the CRC check. */
+inline int proto_decode(const uint8_t *frame, size_t len, uint8_t *record) {
+	uint8_t buf[PROTO_RECORD_MAX + 4];
+	
+	if(len == 0 || len > COBS_MAX_ENCODED(sizeof(buf)))
+		return -1;
+	
+	int n = cobs_decode(frame, len, buf, sizeof(buf));
+	
+	if(n < 5)
+		return -1;
+	
+	uint32_t crc;
+	memcpy(&crc, buf + n - 4, 4);
+	
+	if(crc != crc32(buf, n - 4))
+		return -1;
+	
+	memcpy(record, buf, n - 4);
+	
+	return n - 4;
+}
+
+// -------------------------------------------------
+
+// Firmware only, see protocol.cpp. Assigns the sequence number.
+void proto_send(proto_header_t &record, size_t len);
+
+#endif
@@ -0,0 +1,148 @@
+#include <stddef.h>
+
+#include <libopencm3/stm32/adc.h>
+
+#include "hal.h"
+#include "settings.h"
+#include "crc.h"
+
+// --------------------------------------------
+
+chrono_settings_t settings;
+
+// ADC_SMPR_SMP_* sample times, in tenths of ADC cycles
+static const uint16_t adc_sample_cycles_x10[] = {
+	15, 75, 135, 285, 415, 555, 715, 2395
+};
+
+// ADC conversion time is the sample time + 12.5 cycles
+#define ADC_CONVERSION_CYCLES_X10 125
+
+// PCLK2 frequency (MHz), as set by rcc_clock_setup_in_hse_8mhz_out_72mhz()
+#define PCLK2_MHZ 72
+
+// --------------------------------------------
+
+void settings_defaults(chrono_settings_t &s) {
+	s = {
+		.magic = SETTINGS_MAGIC,
+		.version = SETTINGS_VERSION,
+
+		.peak_threshold = PEAK_THRESHOLD,
+		.peak_lag = PEAK_LAG,
+		.peak_influence = PEAK_INFLUENCE,
+
+		.adc_sample_time = ADC_SAMPLE_TIME,
+		.adc_prescaler = ADC_PRESCALER,
+
+		.distance_um = DISTANCE_UM,
+		.calibration = SPEED_CALIBRATION_FACTOR,
+
+		.mode = mode_fps,
+		.output = output_text,
+		.weight = WEIGHT,
+
+		.log = log_off,
+
+		.crc = 0
+	};
+}
+
+// Time of a single ADC conversion, without the loop (ps)
+uint32_t settings_conversion_ps(const chrono_settings_t &s) {
+	uint32_t cycles_x10 = adc_sample_cycles_x10[s.adc_sample_time & 0x7]
+		+ ADC_CONVERSION_CYCLES_X10;
+
+	return cycles_x10 * s.adc_prescaler * 100000 / PCLK2_MHZ;
+}
+
+/* Estimated time per sample of the measurement loop. This model
+ * reproduces the measurements listed in adc_init() to within ~0.1 us. */
+uint32_t settings_sample_period_ns(const chrono_settings_t &s) {
+	return settings_conversion_ps(s) / 1000 + SETTINGS_LOOP_OVERHEAD_NS;
+}
+
+uint32_t settings_crc(const chrono_settings_t &s) {
+	return crc32(&s, offsetof(chrono_settings_t, crc));
+}
+
+bool settings_validate(const chrono_settings_t &s) {
+	if(s.peak_lag < 1 || s.peak_lag > PEAK_LAG_MAX)
+		return false;
+
+	// 12-bit ADC
+	if(s.peak_threshold < 1 || s.peak_threshold > 4095)
+		return false;
+
+	// The integer peak detection only supports 0 or 1
+	if(s.peak_influence > 1)
+		return false;
+
+	if(s.adc_sample_time > ADC_SMPR_SMP_239DOT5CYC)
+		return false;
+
+	if(s.adc_prescaler < 2 || s.adc_prescaler > 8 || (s.adc_prescaler & 1))
+		return false;
+
+	if(s.mode > mode_rps)
+		return false;
+
+	if(s.output > output_binary)
+		return false;
+
+	if(s.log > log_text)
+		return false;
+
+	if(!(s.calibration > 0.5f && s.calibration < 1.5f))
+		return false;
+
+	if(s.weight < 1 || s.weight > SETTINGS_MAX_WEIGHT)
+		return false;
+
+	/* The projectile must spend at least SETTINGS_MIN_AREA_SAMPLES
+	 * samples inside the detection area, at the maximum speed.
+	 * um / (m/s) = us, so the ns value is um * 1000 / (m/s). */
+	uint32_t area_ns = (uint32_t) SETTINGS_DETECTION_AREA_UM
+		* 1000 / SETTINGS_MAX_SPEED_MPS;
+
+	if(settings_sample_period_ns(s) * SETTINGS_MIN_AREA_SAMPLES > area_ns)
+		return false;
+
+	/* The timer must not overflow before a projectile
+	 * at the minimum speed reaches the rear diode. */
+	uint32_t max_dt_us = (uint32_t) ((uint64_t) TIMER_ARR * 1000000 / TIMER_FREQ);
+
+	if(s.distance_um == 0
+			|| s.distance_um / SETTINGS_MIN_SPEED_MPS > max_dt_us)
+		return false;
+
+	return true;
+}
+
+// --------------------------------------------
+
+bool settings_load() {
+	const chrono_settings_t *stored = (const chrono_settings_t *) hal_flash_page();
+
+	if(stored->magic == SETTINGS_MAGIC
+			&& stored->version == SETTINGS_VERSION
+			&& stored->crc == settings_crc(*stored)
+			&& settings_validate(*stored)) {
+		settings = *stored;
+		return true;
+	}
+
+	settings_defaults(settings);
+	return false;
+}
+
+bool settings_save() {
+	if(!settings_validate(settings))
+		return false;
+
+	settings.magic = SETTINGS_MAGIC;
+	settings.version = SETTINGS_VERSION;
+	settings.crc = settings_crc(settings);
+
+	return hal_flash_write(&settings, sizeof(settings));
+}
@@ -0,0 +1,76 @@
+#ifndef SETTINGS_H
+#define SETTINGS_H
+
+#include <stdint.h>
+
+#include "chronograph.h"
+
+// -------------------------------------------------
+
+#define SETTINGS_MAGIC 0x5C4E
+#define SETTINGS_VERSION 2
+
+/* Limits used to validate the settings. See the
+ * discussion in adc_init() regarding their origin. */
+
+// Maximum projectile speed we wish to measure (m/s)
+#define SETTINGS_MAX_SPEED_MPS 250
+
+// Minimum speed that should fit in the timer's range (m/s)
+#define SETTINGS_MIN_SPEED_MPS 20
+
+// Worst-case diode detection area (10^-6 m)
+#define SETTINGS_DETECTION_AREA_UM 3000
+
+// Samples required inside the detection area
+#define SETTINGS_MIN_AREA_SAMPLES 2
+
+// Per-sample time spent outside of the ADC conversion (ns)
+#define SETTINGS_LOOP_OVERHEAD_NS 1300
+
+// Heaviest projectile (10^-2 g), the stat page shows it as ".xx"
+#define SETTINGS_MAX_WEIGHT 99
+
+// -------------------------------------------------
+
+/* Stored in flash as-is, see hal_flash_page(). So, only append
+ * fields and bump SETTINGS_VERSION when changing it. */
+typedef struct {
+	uint16_t magic;
+	uint16_t version;
+
+	uint16_t peak_threshold;
+	uint16_t peak_lag;
+	uint16_t peak_influence;
+
+	// ADC_SMPR_SMP_* value and PCLK2 divider (2, 4, 6, 8)
+	uint8_t adc_sample_time;
+	uint8_t adc_prescaler;
+
+	uint32_t distance_um;
+	float calibration;
+
+	uint8_t mode;
+	uint8_t output;
+	uint16_t weight;
+
+	uint8_t log;
+
+	uint32_t crc;
+} chrono_settings_t;
+
+extern chrono_settings_t settings;
+
+// -------------------------------------------------
+
+void settings_defaults(chrono_settings_t &s);
+bool settings_validate(const chrono_settings_t &s);
+
+bool settings_load();
+bool settings_save();
+
+uint32_t settings_conversion_ps(const chrono_settings_t &s);
+uint32_t settings_sample_period_ns(const chrono_settings_t &s);
+uint32_t settings_crc(const chrono_settings_t &s);
+
+#endif
@@ -0,0 +1,51 @@
+#include <string.h>
+
+#include "snapshot.h"
+
+// --------------------------------------------
+
+uint16_t snap_ring[SNAP_RING];
+
+static snapshot_t snapshots[SNAP_SHOTS];
+static uint32_t num_snapshots;
+
+// --------------------------------------------
+
+// Returns false if the window was overwritten
+static bool copy_window(uint16_t *dst, uint32_t trigger, uint32_t pos) {
+	uint32_t start = (trigger - SNAP_PRE) & (SNAP_RING - 1);
+	uint32_t first = SNAP_RING - start;
+	
+	if(pos - (trigger - SNAP_PRE) > SNAP_RING) {
+		memset(dst, 0, SNAP_WINDOW * sizeof(*dst));
+		return false;
+	}
+	
+	if(first >= SNAP_WINDOW)
+		memcpy(dst, &snap_ring[start], SNAP_WINDOW * sizeof(*dst));
+	else {
+		memcpy(dst, &snap_ring[start], first * sizeof(*dst));
+		memcpy(dst + first, snap_ring, (SNAP_WINDOW - first) * sizeof(*dst));
+	}
+	
+	return true;
+}
+
+void snap_capture(uint32_t shot, uint16_t ticks,
+		uint32_t front, uint32_t rear, uint32_t pos) {
+	
+	snapshot_t &snap = snapshots[num_snapshots++ % SNAP_SHOTS];
+	
+	snap.shot = shot;
+	snap.ticks = ticks;
+	
+	snap.valid[SNAP_FRONT] = copy_window(snap.samples[SNAP_FRONT], front, pos);
+	snap.valid[SNAP_REAR] = copy_window(snap.samples[SNAP_REAR], rear, pos);
+}
+
+const snapshot_t *snap_get(uint8_t k) {
+	if(k >= SNAP_SHOTS || k >= num_snapshots)
+		return NULL;
+	
+	return &snapshots[(num_snapshots - 1 - k) % SNAP_SHOTS];
+}
@@ -0,0 +1,94 @@
+/**
+ * Pre/post-trigger waveform snapshots.
+ *
+ * Every sample of the measurement loop is written to a ring, which
+ * only costs a store and an increment. After a shot, once SNAP_POST
+ * samples have followed the rear trigger, the windows around both
+ * triggers are copied out of the ring, and the last SNAP_SHOTS
+ * shots are kept. Copying happens between shots, never while one
+ * is in flight.
+ *
+ * The ADC follows the state machine. After the rear trigger, it stays
+ * on the rear gate for SNAP_POST samples, so the rear window holds
+ * the whole pulse. After the front trigger though, it has to switch
+ * to the rear gate at once, not to delay the rear trigger: the front
+ * window's SNAP_PRE samples are of the front gate, and the rest of the
+ * rear one. The front pulse's trailing edge isn't captured.
+ *
+ * No front trigger is detected before the rear window is captured,
+ * so a snapshot's windows, shot number and ticks are of one shot.
+ *
+ * In output_binary mode, the snapshots are sent as PROTO_SNAP records
+ * after the shot's record. Otherwise, see the `snap` command.
+ */
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdint.h>
+
+#include "protocol.h"
+
+// -------------------------------------------------
+
+// Samples before and after (from) the trigger sample
+#define SNAP_PRE 64
+#define SNAP_POST 64
+#define SNAP_WINDOW (SNAP_PRE + SNAP_POST)
+
+/* Ring size, in samples. Power of 2. Has to cover a shot at the
+ * slowest speed and shortest sample time (see settings.h), plus
+ * the windows, or the front window is lost. */
+#define SNAP_RING 2048
+
+#define SNAP_SHOTS 4
+
+#define SNAP_FRONT 0
+#define SNAP_REAR 1
+
+typedef struct {
+	// counters.shots, after the shot
+	uint32_t shot;
+	uint16_t ticks;
+	
+	// False if a window was already overwritten in the ring
+	bool valid[2];
+	
+	uint16_t samples[2][SNAP_WINDOW];
+} snapshot_t;
+
+typedef struct __attribute__((packed)) {
+	proto_header_t header;
+	
+	uint32_t shot;
+	uint16_t ticks;
+	
+	// SNAP_FRONT or SNAP_REAR
+	uint8_t trigger;
+	
+	// Index of the trigger sample
+	uint8_t pre;
+	
+	uint16_t samples[SNAP_WINDOW];
+} proto_snap_t;
+
+static_assert(sizeof(proto_snap_t) <= PROTO_RECORD_MAX, "Record too large");
+
+extern uint16_t snap_ring[SNAP_RING];
+
+// -------------------------------------------------
+
+// Once per sample. pos is the caller's count of samples.
+inline void snap_sample(uint32_t &pos, uint16_t value) {
+	snap_ring[pos++ & (SNAP_RING - 1)] = value;
+}
+
+/* Copy the windows of a shot, whose triggers were at ring
+ * positions front and rear, once pos - rear >= SNAP_POST. */
+void snap_capture(uint32_t shot, uint16_t ticks,
+	uint32_t front, uint32_t rear, uint32_t pos);
+
+// k = 0 is the newest, NULL if there's no such snapshot
+const snapshot_t *snap_get(uint8_t k);
+
+#endif
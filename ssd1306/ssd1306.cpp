@@ -1,215 +1,246 @@
 #include <math.h>
 #include <stdlib.h>
-
-#include <libopencm3/stm32/gpio.h>
-#include <libopencm3/stm32/rcc.h>
-#include <libopencm3/stm32/i2c.h>
+#include <string.h>
 
 #include "ssd1306.h"
 
-#include <core/usb_vcp.h>
-
-#if defined(SSD1306_USE_I2C)
+static void ssd1306_InvalidateShadow(void);
 
-/* OpenCM3 I2C code stolen/adapted from libopencm3-examples,
- * stm32/f1/other/i2c_stts75_sensor */
+// Display transfer queue. Transfers are started by the transport
+// and are removed from the queue once they complete, from its ISR.
+static SSD1306_XFER SSD1306_Queue[SSD1306_QUEUE_SIZE];
+static volatile uint8_t SSD1306_QueueHead;
+static volatile uint8_t SSD1306_QueueTail;
 
-void i2c_init(void) {
-	rcc_periph_clock_enable(SSD1306_I2C_RCC);
-	rcc_periph_clock_enable(RCC_AFIO);
-	
-	gpio_set_mode(GPIOB, GPIO_MODE_OUTPUT_50_MHZ,
-		GPIO_CNF_OUTPUT_ALTFN_OPENDRAIN,
-		SSD1306_I2C_GPIO_SCL | SSD1306_I2C_GPIO_SDA);
-    
-    i2c_peripheral_disable(SSD1306_I2C_PORT);
-    
-    i2c_set_clock_frequency(SSD1306_I2C_PORT, I2C_CR2_FREQ_36MHZ);	
-    i2c_set_fast_mode(SSD1306_I2C_PORT);
-    i2c_set_ccr(SSD1306_I2C_PORT, 0x1e);
-    i2c_set_trise(SSD1306_I2C_PORT, 0x0b);
+// The transfer in progress, or next to start
+SSD1306_XFER *ssd1306_TransferPeek(void) {
+    if(SSD1306_QueueHead == SSD1306_QueueTail)
+        return NULL;
     
-    i2c_enable_ack(SSD1306_I2C_PORT);
-    i2c_peripheral_enable(SSD1306_I2C_PORT);
+    return &SSD1306_Queue[SSD1306_QueueTail];
 }
 
-void i2c_write(uint8_t opcode, uint8_t *data, size_t size) {
-	uint32_t reg32 __attribute__((unused));
-	constexpr uint32_t i2c = SSD1306_I2C_PORT;
-	
-	i2c_send_start(i2c);
-	while(!((I2C_SR1(i2c) & I2C_SR1_SB)
-		& (I2C_SR2(i2c) & (I2C_SR2_MSL | I2C_SR2_BUSY))));
-	
-	i2c_send_7bit_address(i2c, SSD1306_I2C_ADDR, I2C_WRITE);
-	while(!(I2C_SR1(i2c) & I2C_SR1_ADDR));
-	
-	reg32 = I2C_SR2(i2c);
-	
-	i2c_send_data(i2c, opcode);
-	while (!(I2C_SR1(i2c) & I2C_SR1_BTF));
-	
-	for(size_t i = 0; i < size; i++) {
-		i2c_send_data(i2c, data[i]);
-		while (!(I2C_SR1(i2c) & (I2C_SR1_BTF | I2C_SR1_TxE)));
-	}
-	
-	i2c_send_stop(i2c);
+void ssd1306_TransferDone(void) {
+    SSD1306_QueueTail = (SSD1306_QueueTail + 1) % SSD1306_QUEUE_SIZE;
 }
 
-void ssd1306_Reset(void) {
-	/* for I2C - do nothing */
+// Drop all queued transfers, and resend everything on the next update
+void ssd1306_TransferAbort(void) {
+    SSD1306_QueueTail = SSD1306_QueueHead;
+    ssd1306_InvalidateShadow();
 }
 
-// Send a byte to the command register
-void ssd1306_WriteCommand(uint8_t byte) {
-	// HAL_I2C_Mem_Write(&SSD1306_I2C_PORT, SSD1306_I2C_ADDR, 0x00, 1, &byte, 1, HAL_MAX_DELAY);
-	
-	i2c_write(0x00, &byte, 1);
+// Transfer hooks, see ssd1306_SetTransferHooks()
+static void (*SSD1306_StartedHook)(void);
+static void (*SSD1306_FinishedHook)(void);
+
+void ssd1306_SetTransferHooks(void (*started)(void), void (*finished)(void)) {
+    SSD1306_StartedHook = started;
+    SSD1306_FinishedHook = finished;
 }
 
-// Send data
-void ssd1306_WriteData(uint8_t* buffer, size_t buff_size) {
-	// HAL_I2C_Mem_Write(&SSD1306_I2C_PORT, SSD1306_I2C_ADDR, 0x40, 1, buffer, buff_size, HAL_MAX_DELAY);
-	
-	i2c_write(0x40, buffer, buff_size);
+void ssd1306_TransferStarted(void) {
+    if(SSD1306_StartedHook)
+        SSD1306_StartedHook();
 }
 
-/* #elif defined(SSD1306_USE_SPI)
+void ssd1306_TransferFinished(void) {
+    if(SSD1306_FinishedHook)
+        SSD1306_FinishedHook();
+}
 
-void ssd1306_Reset(void) {
-	// CS = High (not selected)
-	HAL_GPIO_WritePin(SSD1306_CS_Port, SSD1306_CS_Pin, GPIO_PIN_SET);
+// Commands that fit in the transfer are copied, otherwise
+// the caller must keep them unchanged until they're sent.
+// Transfers with data hold at most SSD1306_XFER_CMDS commands
+// (the I2C transport's header), longer streams go separately.
+static void ssd1306_Enqueue(const uint8_t *cmds, size_t num_cmds,
+        const uint8_t *data, size_t len) {
+    
+    if(len && num_cmds > SSD1306_XFER_CMDS) {
+        ssd1306_Enqueue(cmds, num_cmds, NULL, 0);
+        
+        cmds = NULL;
+        num_cmds = 0;
+    }
+    
+    uint8_t head = SSD1306_QueueHead;
+    uint8_t next = (head + 1) % SSD1306_QUEUE_SIZE;
+    
+    // Queue full, wait for the transport to catch up
+    while(next == SSD1306_QueueTail);
+    
+    SSD1306_XFER *xfer = &SSD1306_Queue[head];
+    
+    if(num_cmds <= SSD1306_XFER_CMDS) {
+        if(num_cmds)
+            memcpy(xfer->CmdBuf, cmds, num_cmds);
+        xfer->Cmds = xfer->CmdBuf;
+    } else
+        xfer->Cmds = cmds;
+    
+    xfer->NumCmds = num_cmds;
+    xfer->Data = data;
+    xfer->Len = len;
+    
+    SSD1306_QueueHead = next;
+    
+    ssd1306_TransportKick();
+}
 
-	// Reset the OLED
-	HAL_GPIO_WritePin(SSD1306_Reset_Port, SSD1306_Reset_Pin, GPIO_PIN_RESET);
-	HAL_Delay(10);
-	HAL_GPIO_WritePin(SSD1306_Reset_Port, SSD1306_Reset_Pin, GPIO_PIN_SET);
-	HAL_Delay(10);
+uint8_t ssd1306_IsBusy(void) {
+    return SSD1306_QueueHead != SSD1306_QueueTail;
 }
 
 // Send a byte to the command register
 void ssd1306_WriteCommand(uint8_t byte) {
-    HAL_GPIO_WritePin(SSD1306_CS_Port, SSD1306_CS_Pin, GPIO_PIN_RESET); // select OLED
-    HAL_GPIO_WritePin(SSD1306_DC_Port, SSD1306_DC_Pin, GPIO_PIN_RESET); // command
-    HAL_SPI_Transmit(&SSD1306_SPI_PORT, (uint8_t *) &byte, 1, HAL_MAX_DELAY);
-    HAL_GPIO_WritePin(SSD1306_CS_Port, SSD1306_CS_Pin, GPIO_PIN_SET); // un-select OLED
+	ssd1306_Enqueue(&byte, 1, NULL, 0);
+}
+
+// Send a command stream in a single transfer
+void ssd1306_WriteCommands(const uint8_t* cmds, size_t num_cmds) {
+	ssd1306_Enqueue(cmds, num_cmds, NULL, 0);
 }
 
 // Send data
-void ssd1306_WriteData(uint8_t* buffer, size_t buff_size) {
-    HAL_GPIO_WritePin(SSD1306_CS_Port, SSD1306_CS_Pin, GPIO_PIN_RESET); // select OLED
-    HAL_GPIO_WritePin(SSD1306_DC_Port, SSD1306_DC_Pin, GPIO_PIN_SET); // data
-    HAL_SPI_Transmit(&SSD1306_SPI_PORT, buffer, buff_size, HAL_MAX_DELAY);
-    HAL_GPIO_WritePin(SSD1306_CS_Port, SSD1306_CS_Pin, GPIO_PIN_SET); // un-select OLED
+void ssd1306_WriteData(const uint8_t* buffer, size_t buff_size) {
+	ssd1306_Enqueue(NULL, 0, buffer, buff_size);
+}
+
+// Send commands followed by data, in a single transfer if
+// there are up to SSD1306_XFER_CMDS commands
+void ssd1306_WriteCommandsData(const uint8_t* cmds, size_t num_cmds,
+        const uint8_t* buffer, size_t buff_size) {
+	ssd1306_Enqueue(cmds, num_cmds, buffer, buff_size);
 }
-*/
-#else
-// #error "You should define SSD1306_USE_SPI or SSD1306_USE_I2C macro"
-#error "You should define SSD1306_USE_I2C macro"
-#endif
 
 
 // Screenbuffer
 static uint8_t SSD1306_Buffer[SSD1306_WIDTH * SSD1306_HEIGHT / 8];
 
+// Screenbuffer contents last sent to the display's RAM
+static uint8_t SSD1306_Shadow[sizeof(SSD1306_Buffer)];
+
+// Set once the shadow matches the display's RAM. Until then,
+// updates send whole pages regardless of what's dirty.
+static volatile uint8_t SSD1306_ShadowValid;
+
+// Columns written to since the last update, per page.
+// First > Last means the page is clean.
+static SSD1306_DIRTY SSD1306_Dirty[SSD1306_PAGES];
+
 // Screen object
 static SSD1306_t SSD1306;
 
-// Initialize the oled screen
-void ssd1306_Init(void) {
-	// Reset OLED
-	ssd1306_Reset();
-
-    // Wait for the screen to boot, ~100ms (stm32f103)
-    // HAL_Delay(100);
-	for(int i = 0; i < 800000; i++)
-		__asm__("nop");
-	
-	i2c_init();
-	
-    // Init OLED
-    ssd1306_WriteCommand(0xAE); //display off
+static void ssd1306_InvalidateShadow(void) {
+    SSD1306_ShadowValid = 0;
+}
 
-    ssd1306_WriteCommand(0x20); //Set Memory Addressing Mode   
-    ssd1306_WriteCommand(0x00); // 00b,Horizontal Addressing Mode; 01b,Vertical Addressing Mode;
-                                // 10b,Page Addressing Mode (RESET); 11b,Invalid
+static inline void ssd1306_MarkDirty(uint8_t page, uint8_t first, uint8_t last) {
+    if(first < SSD1306_Dirty[page].First)
+        SSD1306_Dirty[page].First = first;
+    if(last > SSD1306_Dirty[page].Last)
+        SSD1306_Dirty[page].Last = last;
+}
 
-    ssd1306_WriteCommand(0xB0); //Set Page Start Address for Page Addressing Mode,0-7
+// Init sequence, sent as a single command stream
+static const uint8_t SSD1306_InitCmds[] = {
+    0xAE, //display off
+    
+    0x20, //Set Memory Addressing Mode   
+    0x00, // 00b,Horizontal Addressing Mode; 01b,Vertical Addressing Mode;
+          // 10b,Page Addressing Mode (RESET); 11b,Invalid
+    
+    0xB0, //Set Page Start Address for Page Addressing Mode,0-7
 
 #ifdef SSD1306_MIRROR_VERT
-    ssd1306_WriteCommand(0xC0); // Mirror vertically
+    0xC0, // Mirror vertically
 #else
-    ssd1306_WriteCommand(0xC8); //Set COM Output Scan Direction
+    0xC8, //Set COM Output Scan Direction
 #endif
 
-    ssd1306_WriteCommand(0x00); //---set low column address
-    ssd1306_WriteCommand(0x10); //---set high column address
-
-    ssd1306_WriteCommand(0x40); //--set start line address - CHECK
-
-    ssd1306_WriteCommand(0x81); //--set contrast control register - CHECK
-    ssd1306_WriteCommand(0xFF);
+    0x00, //---set low column address
+    0x10, //---set high column address
+    
+    0x40, //--set start line address - CHECK
+    
+    0x81, //--set contrast control register - CHECK
+    0xFF,
 
 #ifdef SSD1306_MIRROR_HORIZ
-    ssd1306_WriteCommand(0xA0); // Mirror horizontally
+    0xA0, // Mirror horizontally
 #else
-    ssd1306_WriteCommand(0xA1); //--set segment re-map 0 to 127 - CHECK
+    0xA1, //--set segment re-map 0 to 127 - CHECK
 #endif
 
 #ifdef SSD1306_INVERSE_COLOR
-    ssd1306_WriteCommand(0xA7); //--set inverse color
+    0xA7, //--set inverse color
 #else
-    ssd1306_WriteCommand(0xA6); //--set normal color
+    0xA6, //--set normal color
 #endif
 
 // Set multiplex ratio.
 #if (SSD1306_HEIGHT == 128)
     // Found in the Luma Python lib for SH1106.
-    ssd1306_WriteCommand(0xFF);
+    0xFF,
 #else
-    ssd1306_WriteCommand(0xA8); //--set multiplex ratio(1 to 64) - CHECK
+    0xA8, //--set multiplex ratio(1 to 64) - CHECK
 #endif
 
 #if (SSD1306_HEIGHT == 32)
-    ssd1306_WriteCommand(0x1F); //
+    0x1F, //
 #elif (SSD1306_HEIGHT == 64)
-    ssd1306_WriteCommand(0x3F); //
+    0x3F, //
 #elif (SSD1306_HEIGHT == 128)
-    ssd1306_WriteCommand(0x3F); // Seems to work for 128px high displays too.
+    0x3F, // Seems to work for 128px high displays too.
 #else
 #error "Only 32, 64, or 128 lines of height are supported!"
 #endif
 
-    ssd1306_WriteCommand(0xA4); //0xa4,Output follows RAM content;0xa5,Output ignores RAM content
-
-    ssd1306_WriteCommand(0xD3); //-set display offset - CHECK
-    ssd1306_WriteCommand(0x00); //-not offset
-
-    ssd1306_WriteCommand(0xD5); //--set display clock divide ratio/oscillator frequency
-    ssd1306_WriteCommand(0xF0); //--set divide ratio
-
-    ssd1306_WriteCommand(0xD9); //--set pre-charge period
-    ssd1306_WriteCommand(0x22); //
-
-    ssd1306_WriteCommand(0xDA); //--set com pins hardware configuration - CHECK
+    0xA4, //0xa4,Output follows RAM content;0xa5,Output ignores RAM content
+    
+    0xD3, //-set display offset - CHECK
+    0x00, //-not offset
+    
+    0xD5, //--set display clock divide ratio/oscillator frequency
+    0xF0, //--set divide ratio
+    
+    0xD9, //--set pre-charge period
+    0x22, //
+    
+    0xDA, //--set com pins hardware configuration - CHECK
 #if (SSD1306_HEIGHT == 32)
-    ssd1306_WriteCommand(0x02);
+    0x02,
 #elif (SSD1306_HEIGHT == 64)
-    ssd1306_WriteCommand(0x12);
+    0x12,
 #elif (SSD1306_HEIGHT == 128)
-    ssd1306_WriteCommand(0x12);
+    0x12,
 #else
 #error "Only 32, 64, or 128 lines of height are supported!"
 #endif
 
-    ssd1306_WriteCommand(0xDB); //--set vcomh
-    ssd1306_WriteCommand(0x20); //0x20,0.77xVcc
-
-    ssd1306_WriteCommand(0x8D); //--set DC-DC enable
-    ssd1306_WriteCommand(0x14); //
-    ssd1306_WriteCommand(0xAF); //--turn on SSD1306 panel
+    0xDB, //--set vcomh
+    0x20, //0x20,0.77xVcc
+    
+    0x8D, //--set DC-DC enable
+    0x14, //
+    0xAF, //--turn on SSD1306 panel
+};
 
+// Initialize the oled screen
+void ssd1306_Init(void) {
+	// Reset OLED
+	ssd1306_Reset();
+    
+    // Wait for the screen to boot, ~100ms (stm32f103)
+    // HAL_Delay(100);
+	for(int i = 0; i < 800000; i++)
+		__asm__("nop");
+	
+	ssd1306_TransportInit();
+    
+    // Init OLED
+    ssd1306_WriteCommands(SSD1306_InitCmds, sizeof(SSD1306_InitCmds));
+    
     // Clear screen
     ssd1306_Fill(Black);
     
@@ -223,16 +254,45 @@ void ssd1306_Init(void) {
     SSD1306.Initialized = 1;
 }
 
+// Screenbuffer contents, in the display's RAM layout
+const uint8_t *ssd1306_GetBuffer(void) {
+    return SSD1306_Buffer;
+}
+
 // Fill the whole screen with the given color
 void ssd1306_Fill(SSD1306_COLOR color) {
-    /* Set memory */
-    uint32_t i;
+    ssd1306_FillPages(0, SSD1306_PAGES - 1, color);
+}
 
-    for(i = 0; i < sizeof(SSD1306_Buffer); i++) {
-        SSD1306_Buffer[i] = (color == Black) ? 0x00 : 0xFF;
+// Fill the pages first_page..last_page with the given color
+void ssd1306_FillPages(uint8_t first_page, uint8_t last_page, SSD1306_COLOR color) {
+    if(last_page >= SSD1306_PAGES)
+        last_page = SSD1306_PAGES - 1;
+    if(first_page > last_page)
+        return;
+    
+    memset(&SSD1306_Buffer[first_page * SSD1306_WIDTH],
+        (color == Black) ? 0x00 : 0xFF,
+        (last_page - first_page + 1) * SSD1306_WIDTH);
+    
+    for(uint8_t i = first_page; i <= last_page; i++) {
+        ssd1306_MarkDirty(i, 0, SSD1306_WIDTH - 1);
     }
 }
 
+// Queue a transfer of the shadow's contents in the given window.
+// Full-width windows span multiple pages contiguously.
+static void ssd1306_SendWindow(uint8_t first, uint8_t last,
+        uint8_t first_page, uint8_t last_page) {
+    
+    // Horizontal addressing mode, column and page window
+    const uint8_t cmds[] = {0x21, first, last, 0x22, first_page, last_page};
+    
+    ssd1306_WriteCommandsData(cmds, sizeof(cmds),
+        &SSD1306_Shadow[SSD1306_WIDTH*first_page + first],
+        (last - first + 1) * (last_page - first_page + 1));
+}
+
 // Write the screenbuffer with changed to the screen
 void ssd1306_UpdateScreen(void) {
     // Write data to each page of RAM. Number of pages
@@ -241,11 +301,72 @@ void ssd1306_UpdateScreen(void) {
     //  * 32px   ==  4 pages
     //  * 64px   ==  8 pages
     //  * 128px  ==  16 pages
-    for(uint8_t i = 0; i < SSD1306_HEIGHT/8; i++) {
-        ssd1306_WriteCommand(0xB0 + i); // Set the current RAM page address.
-        ssd1306_WriteCommand(0x00);
-        ssd1306_WriteCommand(0x10);
-        ssd1306_WriteData(&SSD1306_Buffer[SSD1306_WIDTH*i],SSD1306_WIDTH);
+    //
+    // Only the dirty columns of each page are considered, and
+    // of those, only the span that differs from the shadow.
+    //
+    // The data is queued from the shadow, so that drawing may
+    // continue while it is transferred. Overwriting a span of the
+    // shadow that is still queued only sends the newer data earlier.
+    int first[SSD1306_PAGES], last[SSD1306_PAGES];
+    
+    uint8_t shadow_valid = SSD1306_ShadowValid;
+    SSD1306_ShadowValid = 1;
+    
+    for(uint8_t i = 0; i < SSD1306_PAGES; i++) {
+        first[i] = SSD1306_Dirty[i].First;
+        last[i] = SSD1306_Dirty[i].Last;
+        
+        SSD1306_Dirty[i] = {SSD1306_WIDTH, 0};
+        
+        if(!shadow_valid) {
+            first[i] = 0;
+            last[i] = SSD1306_WIDTH - 1;
+        }
+        
+        uint8_t *buffer = &SSD1306_Buffer[SSD1306_WIDTH*i];
+        uint8_t *shadow = &SSD1306_Shadow[SSD1306_WIDTH*i];
+        
+        if(shadow_valid) {
+            while(first[i] <= last[i] && buffer[first[i]] == shadow[first[i]])
+                first[i]++;
+            while(last[i] > first[i] && buffer[last[i]] == shadow[last[i]])
+                last[i]--;
+        }
+        
+        if(first[i] <= last[i])
+            memcpy(&shadow[first[i]], &buffer[first[i]], last[i] - first[i] + 1);
+    }
+    
+    // Consecutive changed pages are sent as one full-width window
+    // (a full frame is a single transfer), unless sending them
+    // separately, each with its own window, is cheaper.
+    for(uint8_t i = 0; i < SSD1306_PAGES;) {
+        if(first[i] > last[i]) {
+            i++;
+            continue;
+        }
+        
+        uint8_t end = i;
+        int separate = 0;
+        
+        for(; end < SSD1306_PAGES && first[end] <= last[end]; end++)
+            separate += last[end] - first[end] + 1 + SSD1306_XFER_OVERHEAD;
+        
+        if(SSD1306_WIDTH * (end - i) + SSD1306_XFER_OVERHEAD <= separate) {
+            // Columns outside of the changed spans already match
+            for(uint8_t j = i; j < end; j++) {
+                memcpy(&SSD1306_Shadow[SSD1306_WIDTH*j],
+                    &SSD1306_Buffer[SSD1306_WIDTH*j], SSD1306_WIDTH);
+            }
+            
+            ssd1306_SendWindow(0, SSD1306_WIDTH - 1, i, end - 1);
+        } else {
+            for(uint8_t j = i; j < end; j++)
+                ssd1306_SendWindow(first[j], last[j], j, j);
+        }
+        
+        i = end;
     }
 }
 
@@ -264,6 +385,8 @@ void ssd1306_DrawPixel(uint8_t x, uint8_t y, SSD1306_COLOR color) {
         color = (SSD1306_COLOR)!color;
     }
     
+    ssd1306_MarkDirty(y / 8, x, x);
+    
     // Draw in the right color
     if(color == White) {
         SSD1306_Buffer[x + (y / 8) * SSD1306_WIDTH] |= 1 << (y % 8);
@@ -272,6 +395,73 @@ void ssd1306_DrawPixel(uint8_t x, uint8_t y, SSD1306_COLOR color) {
     }
 }
 
+// Draw a vertical span from y1 to y2 (inclusive), a page at a time
+void ssd1306_VLine(uint8_t x, uint8_t y1, uint8_t y2, SSD1306_COLOR color) {
+    if(y1 > y2) {
+        uint8_t y = y1;
+        y1 = y2;
+        y2 = y;
+    }
+    
+    if(x >= SSD1306_WIDTH || y1 >= SSD1306_HEIGHT)
+        return;
+    
+    if(y2 >= SSD1306_HEIGHT)
+        y2 = SSD1306_HEIGHT - 1;
+    
+    if(SSD1306.Inverted)
+        color = (SSD1306_COLOR)!color;
+    
+    uint8_t first = y1 / 8, last = y2 / 8;
+    
+    for(uint8_t page = first; page <= last; page++) {
+        uint8_t mask = 0xFF;
+        
+        if(page == first)
+            mask &= 0xFF << (y1 % 8);
+        if(page == last)
+            mask &= 0xFF >> (7 - y2 % 8);
+        
+        uint8_t *dst = &SSD1306_Buffer[page * SSD1306_WIDTH + x];
+        
+        if(color == White)
+            *dst |= mask;
+        else
+            *dst &= ~mask;
+        
+        ssd1306_MarkDirty(page, x, x);
+    }
+}
+
+// Shift columns x1..x2 of pages first_page..last_page left by n
+// columns. The n columns freed on the right get the given color.
+void ssd1306_ShiftLeft(uint8_t x1, uint8_t x2, uint8_t first_page,
+        uint8_t last_page, uint8_t n, SSD1306_COLOR color) {
+    
+    if(x2 >= SSD1306_WIDTH)
+        x2 = SSD1306_WIDTH - 1;
+    if(last_page >= SSD1306_PAGES)
+        last_page = SSD1306_PAGES - 1;
+    if(x1 > x2 || first_page > last_page)
+        return;
+    
+    uint8_t width = x2 - x1 + 1;
+    
+    if(n > width)
+        n = width;
+    
+    uint8_t fill = ((color == White) != !!SSD1306.Inverted) ? 0xFF : 0x00;
+    
+    for(uint8_t page = first_page; page <= last_page; page++) {
+        uint8_t *row = &SSD1306_Buffer[page * SSD1306_WIDTH + x1];
+        
+        memmove(row, row + n, width - n);
+        memset(row + width - n, fill, n);
+        
+        ssd1306_MarkDirty(page, x1, x2);
+    }
+}
+
 // Draw 1 char to the screen buffer
 // ch       => char om weg te schrijven
 // Font     => Font waarmee we gaan schrijven
@@ -291,16 +481,51 @@ char ssd1306_WriteChar(char ch, FontDef Font, SSD1306_COLOR color) {
         return 0;
     }
     
-    // Use the font to write
-    for(i = 0; i < Font.FontHeight; i++) {
-        b = Font.data[(ch - 32) * Font.FontHeight + i];
-        for(j = 0; j < Font.FontWidth; j++) {
-            if((b << j) & 0x8000)  {
-                ssd1306_DrawPixel(SSD1306.CurrentX + j, (SSD1306.CurrentY + i), (SSD1306_COLOR) color);
-            } else {
-                ssd1306_DrawPixel(SSD1306.CurrentX + j, (SSD1306.CurrentY + i), (SSD1306_COLOR)!color);
+    // Copy the glyph's columns into the buffer, a page at a time.
+    // Set font pixels get the color, the rest get the opposite.
+    uint8_t pages = FONT_PAGES(Font.FontHeight);
+    const uint8_t *glyph = &Font.pages[(ch - 32) * pages * Font.FontWidth];
+    
+    uint8_t x = SSD1306.CurrentX;
+    uint8_t page = SSD1306.CurrentY / 8;
+    uint8_t shift = SSD1306.CurrentY % 8;
+    
+    uint8_t invert = ((color == White) != !SSD1306.Inverted) ? 0xFF : 0x00;
+    
+    for(i = 0; i < pages; i++, page++) {
+        // Rows of the glyph in this page
+        uint8_t rows = Font.FontHeight - i * 8;
+        uint8_t mask = (rows >= 8 ? 0xFF : (1 << rows) - 1);
+        
+        uint8_t *dst = &SSD1306_Buffer[page * SSD1306_WIDTH + x];
+        const uint8_t *src = &glyph[i * Font.FontWidth];
+        
+        if(shift == 0) {
+            // Page-aligned
+            for(j = 0; j < Font.FontWidth; j++)
+                dst[j] = (dst[j] & ~mask) | ((src[j] ^ invert) & mask);
+        } else {
+            // Spans this page and the next one
+            uint8_t mask_lo = mask << shift;
+            uint8_t mask_hi = mask >> (8 - shift);
+            
+            for(j = 0; j < Font.FontWidth; j++) {
+                b = src[j] ^ invert;
+                dst[j] = (dst[j] & ~mask_lo) | ((b << shift) & mask_lo);
+            }
+            
+            if(mask_hi && page + 1 < SSD1306_PAGES) {
+                for(j = 0; j < Font.FontWidth; j++) {
+                    b = src[j] ^ invert;
+                    dst[j + SSD1306_WIDTH] = (dst[j + SSD1306_WIDTH] & ~mask_hi)
+                        | ((b >> (8 - shift)) & mask_hi);
+                }
+                
+                ssd1306_MarkDirty(page + 1, x, x + Font.FontWidth - 1);
             }
         }
+        
+        ssd1306_MarkDirty(page, x, x + Font.FontWidth - 1);
     }
     
     // The current space is now taken
@@ -335,13 +560,18 @@ void ssd1306_SetCursor(uint8_t x, uint8_t y) {
 
 // Draw line by Bresenhem's algorithm
 void ssd1306_Line(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2, SSD1306_COLOR color) {
+  if(x1 == x2) {
+    ssd1306_VLine(x1, y1, y2, color);
+    return;
+  }
+  
   int32_t deltaX = abs(x2 - x1);
   int32_t deltaY = abs(y2 - y1);
   int32_t signX = ((x1 < x2) ? 1 : -1);
   int32_t signY = ((y1 < y2) ? 1 : -1);
   int32_t error = deltaX - deltaY;
   int32_t error2;
-	
+  
   ssd1306_DrawPixel(x2, y2, color);
 	while((x1 != x2) || (y1 != y2))
 	{
@@ -356,7 +586,7 @@ void ssd1306_Line(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2, SSD1306_COLOR
     {
     /*nothing to do*/
     }
-		
+    
     if(error2 < deltaX)
     {
       error += deltaX;
@@ -447,11 +677,11 @@ void ssd1306_DrawCircle(uint8_t par_x,uint8_t par_y,uint8_t par_r,SSD1306_COLOR
   int32_t y = 0;
   int32_t err = 2 - 2 * par_r;
   int32_t e2;
-
+  
   if (par_x >= SSD1306_WIDTH || par_y >= SSD1306_HEIGHT) {
     return;
   }
-
+    
     do {
       ssd1306_DrawPixel(par_x - x, par_y + y, par_color);
       ssd1306_DrawPixel(par_x + x, par_y + y, par_color);
@@ -482,7 +712,7 @@ void ssd1306_DrawCircle(uint8_t par_x,uint8_t par_y,uint8_t par_r,SSD1306_COLOR
           /*nothing to do*/
         }
     } while(x <= 0);
-
+    
     return;
 }
 
@@ -492,7 +722,7 @@ void ssd1306_DrawRectangle(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2, SSD13
   ssd1306_Line(x2,y1,x2,y2,color);
   ssd1306_Line(x2,y2,x1,y2,color);
   ssd1306_Line(x1,y2,x1,y1,color);
-
+  
   return;
 }
 
@@ -9,13 +9,12 @@
 #define __SSD1306_H__
 
 #include <stddef.h>
-#include <_ansi.h>
-
-#include <libopencm3/stm32/i2c.h>
 
 #include "ssd1306_fonts.h"
 
-_BEGIN_STD_C
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 /* #if defined(STM32F0)
 #include "stm32f0xx_hal.h"
@@ -38,10 +37,18 @@ _BEGIN_STD_C
  #error "SSD1306 library was tested only on STM32F1, STM32F3, STM32F4, STM32F7, STM32L0, STM32L4, STM32H7 MCU families. Please modify ssd1306.h if you know what you are doing. Also please send a pull request if it turns out the library works on other MCU's as well!"
 #endif */
 
+// Transport: SSD1306_USE_I2C (default), SSD1306_USE_SPI, or
+// SSD1306_USE_HOST for host builds, implemented outside of this library
+#if !defined(SSD1306_USE_SPI) && !defined(SSD1306_USE_HOST)
 #define SSD1306_USE_I2C
+#endif
 
 /* vvv I2C config vvv */
 
+#if defined(SSD1306_USE_I2C)
+#include <libopencm3/stm32/i2c.h>
+#endif
+
 #ifndef SSD1306_I2C_PORT
 // #define SSD1306_I2C_PORT		hi2c1
 #define SSD1306_I2C_PORT		I2C2
@@ -55,44 +62,58 @@ _BEGIN_STD_C
 #define SSD1306_I2C_ADDR        0x3C
 #endif
 
+#ifndef SSD1306_IRQ_PRIORITY
+#define SSD1306_IRQ_PRIORITY    (8 << 4)
+#endif
+
 /* ^^^ I2C config ^^^ */
 
 /* vvv SPI config vvv */
 
-/* #ifndef SSD1306_SPI_PORT
-#define SSD1306_SPI_PORT        hspi2
+#if defined(SSD1306_USE_SPI)
+#include <libopencm3/stm32/spi.h>
+#endif
+
+#ifndef SSD1306_SPI_PORT
+// #define SSD1306_SPI_PORT        hspi2
+#define SSD1306_SPI_PORT        SPI1
+#define SSD1306_SPI_RCC         RCC_SPI1
+#define SSD1306_SPI_GPIO_Port   GPIOA
+#define SSD1306_SPI_GPIO_SCK    GPIO_SPI1_SCK
+#define SSD1306_SPI_GPIO_MOSI   GPIO_SPI1_MOSI
+#endif
+
+// PCLK2 / 8 = 9 MHz, the SSD1306 allows up to 10 MHz
+#ifndef SSD1306_SPI_BAUDRATE
+#define SSD1306_SPI_BAUDRATE    SPI_CR1_BAUDRATE_FPCLK_DIV_8
 #endif
 
 #ifndef SSD1306_CS_Port
 #define SSD1306_CS_Port         GPIOB
 #endif
 #ifndef SSD1306_CS_Pin
-#define SSD1306_CS_Pin          GPIO_PIN_12
+#define SSD1306_CS_Pin          GPIO12
 #endif
 
 #ifndef SSD1306_DC_Port
 #define SSD1306_DC_Port         GPIOB
 #endif
 #ifndef SSD1306_DC_Pin
-#define SSD1306_DC_Pin          GPIO_PIN_14
+#define SSD1306_DC_Pin          GPIO14
 #endif
 
 #ifndef SSD1306_Reset_Port
 #define SSD1306_Reset_Port      GPIOA
 #endif
 #ifndef SSD1306_Reset_Pin
-#define SSD1306_Reset_Pin       GPIO_PIN_8
-#endif */
+#define SSD1306_Reset_Pin       GPIO8
+#endif
 
 /* ^^^ SPI config ^^^ */
 
-/* #if defined(SSD1306_USE_I2C)
-extern I2C_HandleTypeDef SSD1306_I2C_PORT;
-#elif defined(SSD1306_USE_SPI)
-extern SPI_HandleTypeDef SSD1306_SPI_PORT;
-#else
-#error "You should define SSD1306_USE_SPI or SSD1306_USE_I2C macro!"
-#endif */
+#if defined(SSD1306_USE_I2C) && defined(SSD1306_USE_SPI)
+#error "You should define only one of SSD1306_USE_SPI or SSD1306_USE_I2C"
+#endif
 
 // SSD1306 OLED height in pixels
 #ifndef SSD1306_HEIGHT
@@ -104,6 +125,27 @@ extern SPI_HandleTypeDef SSD1306_SPI_PORT;
 #define SSD1306_WIDTH           128
 #endif
 
+// Number of 8-pixel RAM pages
+#define SSD1306_PAGES           (SSD1306_HEIGHT / 8)
+
+// Number of queued display transfers (commands and data)
+#ifndef SSD1306_QUEUE_SIZE
+#define SSD1306_QUEUE_SIZE      16
+#endif
+
+// Commands stored in each queued transfer
+#define SSD1306_XFER_CMDS       6
+
+// Approximate cost of a transfer, in bytes: the 0x21/0x22 window
+// commands, and for I2C the START, address and control bytes
+#ifndef SSD1306_XFER_OVERHEAD
+#if defined(SSD1306_USE_SPI)
+#define SSD1306_XFER_OVERHEAD   6
+#else
+#define SSD1306_XFER_OVERHEAD   15
+#endif
+#endif
+
 // some LEDs don't display anything in first two columns
 // #define SSD1306_WIDTH           130
 
@@ -125,11 +167,33 @@ typedef struct {
     uint8_t y;
 } SSD1306_VERTEX;
 
+// Range of modified columns in a page
+typedef struct {
+    uint8_t First;
+    uint8_t Last;
+} SSD1306_DIRTY;
+
+// Queued transfer, a command stream optionally followed by data.
+// Cmds points to CmdBuf, unless there are more than SSD1306_XFER_CMDS,
+// which only happens without data.
+typedef struct {
+    const uint8_t *Cmds;
+    const uint8_t *Data;
+    uint16_t NumCmds;
+    uint16_t Len;
+    uint8_t CmdBuf[SSD1306_XFER_CMDS];
+} SSD1306_XFER;
+
 // Procedure definitions
 void ssd1306_Init(void);
 void ssd1306_Fill(SSD1306_COLOR color);
+void ssd1306_FillPages(uint8_t first_page, uint8_t last_page, SSD1306_COLOR color);
 void ssd1306_UpdateScreen(void);
+const uint8_t *ssd1306_GetBuffer(void);
 void ssd1306_DrawPixel(uint8_t x, uint8_t y, SSD1306_COLOR color);
+void ssd1306_VLine(uint8_t x, uint8_t y1, uint8_t y2, SSD1306_COLOR color);
+void ssd1306_ShiftLeft(uint8_t x1, uint8_t x2, uint8_t first_page,
+        uint8_t last_page, uint8_t n, SSD1306_COLOR color);
 char ssd1306_WriteChar(char ch, FontDef Font, SSD1306_COLOR color);
 char ssd1306_WriteString(const char* str, FontDef Font, SSD1306_COLOR color);
 void ssd1306_SetCursor(uint8_t x, uint8_t y);
@@ -140,10 +204,41 @@ void ssd1306_Polyline(const SSD1306_VERTEX *par_vertex, uint16_t par_size, SSD13
 void ssd1306_DrawRectangle(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2, SSD1306_COLOR color);
 
 // Low-level procedures
+//
+// Writes are queued and return immediately, unless the queue is
+// full. Data buffers, and command streams longer than
+// SSD1306_XFER_CMDS, must remain unchanged until ssd1306_IsBusy()
+// returns 0.
 void ssd1306_Reset(void);
 void ssd1306_WriteCommand(uint8_t byte);
-void ssd1306_WriteData(uint8_t* buffer, size_t buff_size);
-
-_END_STD_C
+void ssd1306_WriteCommands(const uint8_t* cmds, size_t num_cmds);
+void ssd1306_WriteData(const uint8_t* buffer, size_t buff_size);
+void ssd1306_WriteCommandsData(const uint8_t* cmds, size_t num_cmds,
+        const uint8_t* buffer, size_t buff_size);
+uint8_t ssd1306_IsBusy(void);
+
+// Called when the transport starts sending queued transfers, and
+// when the queue has drained (from its ISR), e.g. to time them.
+// Either may be NULL.
+void ssd1306_SetTransferHooks(void (*started)(void), void (*finished)(void));
+
+// Transport interface, see ssd1306_i2c.cpp and ssd1306_spi.cpp
+//
+// ssd1306_TransportKick() starts the queued transfers, if the
+// transport is idle. Transfers are consumed in order, with
+// ssd1306_TransferPeek() and ssd1306_TransferDone(). A run of
+// transfers is bracketed by ssd1306_TransferStarted() and
+// ssd1306_TransferFinished(), which call the hooks.
+void ssd1306_TransportInit(void);
+void ssd1306_TransportKick(void);
+SSD1306_XFER *ssd1306_TransferPeek(void);
+void ssd1306_TransferDone(void);
+void ssd1306_TransferAbort(void);
+void ssd1306_TransferStarted(void);
+void ssd1306_TransferFinished(void);
+
+#ifdef __cplusplus
+}
+#endif
 
 #endif // __SSD1306_H__
@@ -1,7 +1,7 @@
 
 #include "ssd1306_fonts.h"
 
-static const uint16_t Font7x10 [] = {
+static constexpr uint16_t Font7x10 [] = {
 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,  // sp
 0x1000, 0x1000, 0x1000, 0x1000, 0x1000, 0x1000, 0x0000, 0x1000, 0x0000, 0x0000,  // !
 0x2800, 0x2800, 0x2800, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,  // "
@@ -99,7 +99,7 @@ static const uint16_t Font7x10 [] = {
 0x0000, 0x0000, 0x0000, 0x7400, 0x4C00, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,  // ~
 };
 
-static const uint16_t Font11x18 [] = {
+static constexpr uint16_t Font11x18 [] = {
 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,   // sp
 0x0000, 0x0C00, 0x0C00, 0x0C00, 0x0C00, 0x0C00, 0x0C00, 0x0C00, 0x0C00, 0x0C00, 0x0C00, 0x0C00, 0x0000, 0x0C00, 0x0C00, 0x0000, 0x0000, 0x0000,   // !
 0x0000, 0x1B00, 0x1B00, 0x1B00, 0x1B00, 0x1B00, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,   // "
@@ -197,7 +197,7 @@ static const uint16_t Font11x18 [] = {
 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x3880, 0x7F80, 0x4700, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,   // ~
 };
 
-static const uint16_t Font16x26 [] = {
+static constexpr uint16_t Font16x26 [] = {
 0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000, // Ascii = [ ]
 0x03E0,0x03E0,0x03E0,0x03E0,0x03E0,0x03E0,0x03E0,0x03E0,0x03C0,0x03C0,0x01C0,0x01C0,0x01C0,0x01C0,0x01C0,0x0000,0x0000,0x0000,0x03E0,0x03E0,0x03E0,0x0000,0x0000,0x0000,0x0000,0x0000, // Ascii = [!]
 0x1E3C,0x1E3C,0x1E3C,0x1E3C,0x1E3C,0x1E3C,0x1E3C,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000, // Ascii = ["]
@@ -295,7 +295,7 @@ static const uint16_t Font16x26 [] = {
 0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x3F07,0x7FC7,0x73E7,0xF1FF,0xF07E,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000, // Ascii = [~]
 };
 
-static const uint16_t Font6x8 [] = {
+static constexpr uint16_t Font6x8 [] = {
 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,  // sp
 0x2000, 0x2000, 0x2000, 0x2000, 0x2000, 0x0000, 0x2000, 0x0000,  // !
 0x5000, 0x5000, 0x5000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,  // "
@@ -393,7 +393,33 @@ static const uint16_t Font6x8 [] = {
 0x4000, 0xa800, 0x1000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,  // ~
 };
 
-FontDef Font_6x8 = {6,8,Font6x8};
-FontDef Font_7x10 = {7,10,Font7x10};
-FontDef Font_11x18 = {11,18,Font11x18};
-FontDef Font_16x26 = {16,26,Font16x26};
+/* Row-major glyphs transposed at compile time to the SSD1306's
+ * RAM layout: for each glyph, FONT_PAGES(Height) pages of Width
+ * bytes, each byte being a column of 8 pixels (LSB at the top). */
+template<uint8_t Width, uint8_t Height>
+struct FontPages {
+	uint8_t data[95 * FONT_PAGES(Height) * Width];
+	
+	constexpr FontPages(const uint16_t *rows) : data() {
+		for(int ch = 0; ch < 95; ch++) {
+			for(int y = 0; y < Height; y++) {
+				uint16_t row = rows[ch * Height + y];
+				
+				for(int x = 0; x < Width; x++) {
+					if((row << x) & 0x8000)
+						data[(ch * FONT_PAGES(Height) + y / 8) * Width + x] |= 1 << (y % 8);
+				}
+			}
+		}
+	}
+};
+
+static constexpr FontPages<6, 8> Font6x8Pages(Font6x8);
+static constexpr FontPages<7, 10> Font7x10Pages(Font7x10);
+static constexpr FontPages<11, 18> Font11x18Pages(Font11x18);
+static constexpr FontPages<16, 26> Font16x26Pages(Font16x26);
+
+FontDef Font_6x8 = {6,8,Font6x8,Font6x8Pages.data};
+FontDef Font_7x10 = {7,10,Font7x10,Font7x10Pages.data};
+FontDef Font_11x18 = {11,18,Font11x18,Font11x18Pages.data};
+FontDef Font_16x26 = {16,26,Font16x26,Font16x26Pages.data};
@@ -7,8 +7,12 @@ typedef struct {
 	const uint8_t FontWidth;    /*!< Font width in pixels */
 	uint8_t FontHeight;   /*!< Font height in pixels */
 	const uint16_t *data; /*!< Pointer to data font data array */
+	const uint8_t *pages; /*!< Pointer to page-aligned, column-major glyphs */
 } FontDef;
 
+// Number of 8-pixel pages per glyph
+#define FONT_PAGES(height) (((height) + 7) / 8)
+
 
 extern FontDef Font_6x8;
 extern FontDef Font_7x10;
@@ -0,0 +1,196 @@
+#include <libopencm3/stm32/gpio.h>
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/i2c.h>
+#include <libopencm3/stm32/dma.h>
+#include <libopencm3/cm3/nvic.h>
+#include <libopencm3/cm3/cortex.h>
+
+#include "ssd1306.h"
+
+#if defined(SSD1306_USE_I2C)
+
+/* OpenCM3 I2C code stolen/adapted from libopencm3-examples,
+ * stm32/f1/other/i2c_stts75_sensor
+ *
+ * Transfers are interrupt-driven. Each one is a START (repeated
+ * START if more transfers are queued), the address, and two DMA1
+ * channel 4 (I2C2_TX) phases, the header and the payload:
+ *
+ * SB -> send address
+ * ADDR -> build the header, start the DMA
+ * DMA TC -> start the payload DMA, or wait for BTF
+ * BTF -> repeated START for the next transfer, or STOP
+ *
+ * The header holds the control bytes. Transfers without data are
+ * a single control byte (Co = 0, D/C# = 0) followed by the command
+ * stream. Transfers with data send each command after a Co = 1
+ * control byte, followed by one Co = 0, D/C# = 1 control byte
+ * and the data stream. */
+
+#define SSD1306_I2C_DMA         DMA1
+#define SSD1306_I2C_DMA_CHANNEL DMA_CHANNEL4
+
+static volatile uint8_t SSD1306_Running;
+
+// Header of the current transfer, and its payload's phase.
+// Transfers with data have at most SSD1306_XFER_CMDS commands.
+static uint8_t SSD1306_I2CHead[2 * SSD1306_XFER_CMDS + 1];
+static volatile uint8_t SSD1306_I2CPayload;
+
+static void i2c_dma_start(const uint8_t *data, size_t len) {
+	dma_set_memory_address(SSD1306_I2C_DMA, SSD1306_I2C_DMA_CHANNEL, (uint32_t) data);
+	dma_set_number_of_data(SSD1306_I2C_DMA, SSD1306_I2C_DMA_CHANNEL, len);
+	dma_enable_channel(SSD1306_I2C_DMA, SSD1306_I2C_DMA_CHANNEL);
+}
+
+static void i2c_init(void) {
+	rcc_periph_clock_enable(SSD1306_I2C_RCC);
+	rcc_periph_clock_enable(RCC_AFIO);
+	rcc_periph_clock_enable(RCC_DMA1);
+	
+	gpio_set_mode(GPIOB, GPIO_MODE_OUTPUT_50_MHZ,
+		GPIO_CNF_OUTPUT_ALTFN_OPENDRAIN,
+		SSD1306_I2C_GPIO_SCL | SSD1306_I2C_GPIO_SDA);
+    
+    i2c_peripheral_disable(SSD1306_I2C_PORT);
+    
+    i2c_set_clock_frequency(SSD1306_I2C_PORT, I2C_CR2_FREQ_36MHZ);	
+    i2c_set_fast_mode(SSD1306_I2C_PORT);
+    i2c_set_ccr(SSD1306_I2C_PORT, 0x1e);
+    i2c_set_trise(SSD1306_I2C_PORT, 0x0b);
+    
+    i2c_enable_ack(SSD1306_I2C_PORT);
+    i2c_peripheral_enable(SSD1306_I2C_PORT);
+    
+    dma_channel_reset(SSD1306_I2C_DMA, SSD1306_I2C_DMA_CHANNEL);
+    dma_set_peripheral_address(SSD1306_I2C_DMA, SSD1306_I2C_DMA_CHANNEL,
+        (uint32_t) &I2C_DR(SSD1306_I2C_PORT));
+    dma_set_read_from_memory(SSD1306_I2C_DMA, SSD1306_I2C_DMA_CHANNEL);
+    dma_enable_memory_increment_mode(SSD1306_I2C_DMA, SSD1306_I2C_DMA_CHANNEL);
+    dma_set_memory_size(SSD1306_I2C_DMA, SSD1306_I2C_DMA_CHANNEL, DMA_CCR_MSIZE_8BIT);
+    dma_set_peripheral_size(SSD1306_I2C_DMA, SSD1306_I2C_DMA_CHANNEL, DMA_CCR_PSIZE_8BIT);
+    dma_set_priority(SSD1306_I2C_DMA, SSD1306_I2C_DMA_CHANNEL, DMA_CCR_PL_LOW);
+    dma_enable_transfer_complete_interrupt(SSD1306_I2C_DMA, SSD1306_I2C_DMA_CHANNEL);
+    
+    // Below the measurement timer's (TIM2) priority
+    nvic_set_priority(NVIC_I2C2_EV_IRQ, SSD1306_IRQ_PRIORITY);
+    nvic_set_priority(NVIC_I2C2_ER_IRQ, SSD1306_IRQ_PRIORITY);
+    nvic_set_priority(NVIC_DMA1_CHANNEL4_IRQ, SSD1306_IRQ_PRIORITY);
+    
+    nvic_enable_irq(NVIC_I2C2_EV_IRQ);
+    nvic_enable_irq(NVIC_I2C2_ER_IRQ);
+    nvic_enable_irq(NVIC_DMA1_CHANNEL4_IRQ);
+    
+    i2c_enable_interrupt(SSD1306_I2C_PORT, I2C_CR2_ITERREN);
+}
+
+void ssd1306_TransportKick(void) {
+	cm_disable_interrupts();
+	
+	if(!SSD1306_Running && ssd1306_TransferPeek()) {
+		SSD1306_Running = 1;
+		
+		ssd1306_TransferStarted();
+		
+		i2c_enable_interrupt(SSD1306_I2C_PORT, I2C_CR2_ITEVTEN);
+		i2c_send_start(SSD1306_I2C_PORT);
+	}
+	
+	cm_enable_interrupts();
+}
+
+extern "C" void i2c2_ev_isr(void) {
+	constexpr uint32_t i2c = SSD1306_I2C_PORT;
+	uint32_t sr1 = I2C_SR1(i2c);
+	
+	if(sr1 & I2C_SR1_SB) {
+		i2c_send_7bit_address(i2c, SSD1306_I2C_ADDR, I2C_WRITE);
+	} else if(sr1 & I2C_SR1_ADDR) {
+		const SSD1306_XFER *xfer = ssd1306_TransferPeek();
+		size_t len = 0;
+		
+		if(xfer->Len == 0) {
+			SSD1306_I2CHead[len++] = 0x00;
+		} else {
+			for(size_t i = 0; i < xfer->NumCmds; i++) {
+				SSD1306_I2CHead[len++] = 0x80;
+				SSD1306_I2CHead[len++] = xfer->Cmds[i];
+			}
+			
+			SSD1306_I2CHead[len++] = 0x40;
+		}
+		
+		SSD1306_I2CPayload = 0;
+		
+		// Clear ADDR
+		(void) I2C_SR2(i2c);
+		
+		// No events until the DMA is done
+		i2c_disable_interrupt(i2c, I2C_CR2_ITEVTEN);
+		
+		i2c_enable_dma(i2c);
+		i2c_dma_start(SSD1306_I2CHead, len);
+	} else if(sr1 & I2C_SR1_BTF) {
+		ssd1306_TransferDone();
+		
+		if(ssd1306_TransferPeek()) {
+			i2c_send_start(i2c);
+		} else {
+			i2c_send_stop(i2c);
+			i2c_disable_interrupt(i2c, I2C_CR2_ITEVTEN);
+			
+			SSD1306_Running = 0;
+			
+			ssd1306_TransferFinished();
+		}
+	}
+}
+
+extern "C" void dma1_channel4_isr(void) {
+	dma_clear_interrupt_flags(SSD1306_I2C_DMA, SSD1306_I2C_DMA_CHANNEL, DMA_TCIF);
+	dma_disable_channel(SSD1306_I2C_DMA, SSD1306_I2C_DMA_CHANNEL);
+	
+	if(!SSD1306_I2CPayload) {
+		const SSD1306_XFER *xfer = ssd1306_TransferPeek();
+		
+		SSD1306_I2CPayload = 1;
+		
+		if(xfer->Len)
+			i2c_dma_start(xfer->Data, xfer->Len);
+		else
+			i2c_dma_start(xfer->Cmds, xfer->NumCmds);
+		
+		return;
+	}
+	
+	i2c_disable_dma(SSD1306_I2C_PORT);
+	
+	// The last byte is still being shifted out, continue on BTF
+	i2c_enable_interrupt(SSD1306_I2C_PORT, I2C_CR2_ITEVTEN);
+}
+
+extern "C" void i2c2_er_isr(void) {
+	constexpr uint32_t i2c = SSD1306_I2C_PORT;
+	
+	// NACK, bus error, arbitration lost, ...
+	I2C_SR1(i2c) &= ~(I2C_SR1_AF | I2C_SR1_BERR | I2C_SR1_ARLO | I2C_SR1_OVR);
+	
+	dma_disable_channel(SSD1306_I2C_DMA, SSD1306_I2C_DMA_CHANNEL);
+	i2c_disable_dma(i2c);
+	i2c_disable_interrupt(i2c, I2C_CR2_ITEVTEN);
+	i2c_send_stop(i2c);
+	
+	SSD1306_Running = 0;
+	
+	ssd1306_TransferAbort();
+}
+
+void ssd1306_TransportInit(void) {
+	i2c_init();
+}
+
+void ssd1306_Reset(void) {
+	/* for I2C - do nothing */
+}
+
+#endif
@@ -0,0 +1,180 @@
+#include <libopencm3/stm32/gpio.h>
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/spi.h>
+#include <libopencm3/stm32/dma.h>
+#include <libopencm3/cm3/nvic.h>
+#include <libopencm3/cm3/cortex.h>
+
+#include "ssd1306.h"
+
+#if defined(SSD1306_USE_SPI)
+
+/* 4-wire SPI: SCK, MOSI (transmit-only), CS# and D/C#.
+ *
+ * Transfers are DMA-driven, on DMA1 channel 3 (SPI1_TX). CS# is
+ * asserted while the queue is being drained. Each transfer is up
+ * to two DMA phases, the commands with D/C# low, and the data
+ * with D/C# high:
+ *
+ * Kick -> CS# low, start the first phase
+ * DMA TC -> wait for the last byte, start the next phase,
+ *   or the next transfer, or CS# high
+ *
+ * D/C# is sampled with the last bit of each byte, so it may only
+ * change once the SPI is idle. At SCK = 9 MHz that's at most two
+ * bytes (< 2 us) after DMA TC, short enough to wait for in the ISR. */
+
+#define SSD1306_SPI_DMA         DMA1
+#define SSD1306_SPI_DMA_CHANNEL DMA_CHANNEL3
+
+static volatile uint8_t SSD1306_Running;
+
+// Phase of the current transfer: 0 none, 1 commands, 2 data
+static volatile uint8_t SSD1306_SPIPhase;
+
+static void spi_dma_start(const uint8_t *data, size_t len) {
+	dma_set_memory_address(SSD1306_SPI_DMA, SSD1306_SPI_DMA_CHANNEL, (uint32_t) data);
+	dma_set_number_of_data(SSD1306_SPI_DMA, SSD1306_SPI_DMA_CHANNEL, len);
+	dma_enable_channel(SSD1306_SPI_DMA, SSD1306_SPI_DMA_CHANNEL);
+}
+
+static void spi_wait_idle(void) {
+	while(!(SPI_SR(SSD1306_SPI_PORT) & SPI_SR_TXE));
+	while(SPI_SR(SSD1306_SPI_PORT) & SPI_SR_BSY);
+}
+
+// Start the transfer's next non-empty phase, if any
+static bool spi_next_phase(const SSD1306_XFER *xfer) {
+	if(SSD1306_SPIPhase == 0) {
+		SSD1306_SPIPhase = 1;
+		
+		if(xfer->NumCmds) {
+			gpio_clear(SSD1306_DC_Port, SSD1306_DC_Pin);
+			spi_dma_start(xfer->Cmds, xfer->NumCmds);
+			return true;
+		}
+	}
+	
+	if(SSD1306_SPIPhase == 1) {
+		SSD1306_SPIPhase = 2;
+		
+		if(xfer->Len) {
+			gpio_set(SSD1306_DC_Port, SSD1306_DC_Pin);
+			spi_dma_start(xfer->Data, xfer->Len);
+			return true;
+		}
+	}
+	
+	return false;
+}
+
+// Continue with the queue, or release CS# once it's empty
+static void spi_continue(void) {
+	const SSD1306_XFER *xfer;
+	
+	while((xfer = ssd1306_TransferPeek())) {
+		if(spi_next_phase(xfer))
+			return;
+		
+		ssd1306_TransferDone();
+		SSD1306_SPIPhase = 0;
+	}
+	
+	gpio_set(SSD1306_CS_Port, SSD1306_CS_Pin);
+	SSD1306_Running = 0;
+	
+	ssd1306_TransferFinished();
+}
+
+static void spi_init(void) {
+	rcc_periph_clock_enable(SSD1306_SPI_RCC);
+	rcc_periph_clock_enable(RCC_AFIO);
+	rcc_periph_clock_enable(RCC_DMA1);
+	
+	gpio_set_mode(SSD1306_SPI_GPIO_Port, GPIO_MODE_OUTPUT_50_MHZ,
+		GPIO_CNF_OUTPUT_ALTFN_PUSHPULL,
+		SSD1306_SPI_GPIO_SCK | SSD1306_SPI_GPIO_MOSI);
+	
+	// Mode 0, MSB first, CS# in software
+	spi_reset(SSD1306_SPI_PORT);
+	spi_init_master(SSD1306_SPI_PORT, SSD1306_SPI_BAUDRATE,
+		SPI_CR1_CPOL_CLK_TO_0_WHEN_IDLE, SPI_CR1_CPHA_CLK_TRANSITION_1,
+		SPI_CR1_DFF_8BIT, SPI_CR1_MSBFIRST);
+	
+	spi_set_bidirectional_transmit_only_mode(SSD1306_SPI_PORT);
+	spi_enable_software_slave_management(SSD1306_SPI_PORT);
+	spi_set_nss_high(SSD1306_SPI_PORT);
+	
+	spi_enable_tx_dma(SSD1306_SPI_PORT);
+	spi_enable(SSD1306_SPI_PORT);
+	
+	dma_channel_reset(SSD1306_SPI_DMA, SSD1306_SPI_DMA_CHANNEL);
+	dma_set_peripheral_address(SSD1306_SPI_DMA, SSD1306_SPI_DMA_CHANNEL,
+		(uint32_t) &SPI_DR(SSD1306_SPI_PORT));
+	dma_set_read_from_memory(SSD1306_SPI_DMA, SSD1306_SPI_DMA_CHANNEL);
+	dma_enable_memory_increment_mode(SSD1306_SPI_DMA, SSD1306_SPI_DMA_CHANNEL);
+	dma_set_memory_size(SSD1306_SPI_DMA, SSD1306_SPI_DMA_CHANNEL, DMA_CCR_MSIZE_8BIT);
+	dma_set_peripheral_size(SSD1306_SPI_DMA, SSD1306_SPI_DMA_CHANNEL, DMA_CCR_PSIZE_8BIT);
+	dma_set_priority(SSD1306_SPI_DMA, SSD1306_SPI_DMA_CHANNEL, DMA_CCR_PL_LOW);
+	dma_enable_transfer_complete_interrupt(SSD1306_SPI_DMA, SSD1306_SPI_DMA_CHANNEL);
+	
+	// Below the measurement timer's (TIM2) priority
+	nvic_set_priority(NVIC_DMA1_CHANNEL3_IRQ, SSD1306_IRQ_PRIORITY);
+	nvic_enable_irq(NVIC_DMA1_CHANNEL3_IRQ);
+}
+
+void ssd1306_TransportKick(void) {
+	cm_disable_interrupts();
+	
+	if(!SSD1306_Running && ssd1306_TransferPeek()) {
+		SSD1306_Running = 1;
+		SSD1306_SPIPhase = 0;
+		
+		ssd1306_TransferStarted();
+		
+		gpio_clear(SSD1306_CS_Port, SSD1306_CS_Pin);
+		spi_continue();
+	}
+	
+	cm_enable_interrupts();
+}
+
+extern "C" void dma1_channel3_isr(void) {
+	dma_clear_interrupt_flags(SSD1306_SPI_DMA, SSD1306_SPI_DMA_CHANNEL, DMA_TCIF);
+	dma_disable_channel(SSD1306_SPI_DMA, SSD1306_SPI_DMA_CHANNEL);
+	
+	spi_wait_idle();
+	spi_continue();
+}
+
+void ssd1306_TransportInit(void) {
+	spi_init();
+}
+
+void ssd1306_Reset(void) {
+	rcc_periph_clock_enable(RCC_GPIOA);
+	rcc_periph_clock_enable(RCC_GPIOB);
+	
+	// CS = High (not selected)
+	gpio_set(SSD1306_CS_Port, SSD1306_CS_Pin);
+	
+	gpio_set_mode(SSD1306_CS_Port, GPIO_MODE_OUTPUT_50_MHZ,
+		GPIO_CNF_OUTPUT_PUSHPULL, SSD1306_CS_Pin);
+	gpio_set_mode(SSD1306_DC_Port, GPIO_MODE_OUTPUT_50_MHZ,
+		GPIO_CNF_OUTPUT_PUSHPULL, SSD1306_DC_Pin);
+	gpio_set_mode(SSD1306_Reset_Port, GPIO_MODE_OUTPUT_2_MHZ,
+		GPIO_CNF_OUTPUT_PUSHPULL, SSD1306_Reset_Pin);
+	
+	// Reset the OLED, ~10 ms low and high
+	gpio_clear(SSD1306_Reset_Port, SSD1306_Reset_Pin);
+	
+	for(int i = 0; i < 80000; i++)
+		__asm__("nop");
+	
+	gpio_set(SSD1306_Reset_Port, SSD1306_Reset_Pin);
+	
+	for(int i = 0; i < 80000; i++)
+		__asm__("nop");
+}
+
+#endif
@@ -0,0 +1,113 @@
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/adc.h>
+#include <libopencm3/stm32/dma.h>
+#include <libopencm3/cm3/nvic.h>
+
+#include "stream.h"
+#include "chronograph.h"
+#include "settings.h"
+
+// --------------------------------------------
+
+// Written by DMA, one block per half
+static uint16_t stream_buf[2][STREAM_BLOCK_SAMPLES];
+
+// Blocks completed by DMA
+static volatile uint32_t stream_blocks;
+
+// --------------------------------------------
+
+extern "C" void dma1_channel1_isr(void) {
+	if(dma_get_interrupt_flag(DMA1, DMA_CHANNEL1, DMA_HTIF)) {
+		dma_clear_interrupt_flags(DMA1, DMA_CHANNEL1, DMA_HTIF);
+		stream_blocks++;
+	}
+	
+	if(dma_get_interrupt_flag(DMA1, DMA_CHANNEL1, DMA_TCIF)) {
+		dma_clear_interrupt_flags(DMA1, DMA_CHANNEL1, DMA_TCIF);
+		stream_blocks++;
+	}
+}
+
+static void stream_start() {
+	uint8_t channels[STREAM_CHANNELS] = {CHANNEL_FRONT, CHANNEL_REAR};
+	
+	rcc_periph_clock_enable(RCC_DMA1);
+	
+	dma_channel_reset(DMA1, DMA_CHANNEL1);
+	dma_set_peripheral_address(DMA1, DMA_CHANNEL1, (uint32_t) &ADC_DR(ADC1));
+	dma_set_memory_address(DMA1, DMA_CHANNEL1, (uint32_t) stream_buf);
+	dma_set_number_of_data(DMA1, DMA_CHANNEL1, sizeof(stream_buf) / sizeof(uint16_t));
+	dma_set_read_from_peripheral(DMA1, DMA_CHANNEL1);
+	dma_enable_memory_increment_mode(DMA1, DMA_CHANNEL1);
+	dma_set_peripheral_size(DMA1, DMA_CHANNEL1, DMA_CCR_PSIZE_16BIT);
+	dma_set_memory_size(DMA1, DMA_CHANNEL1, DMA_CCR_MSIZE_16BIT);
+	dma_set_priority(DMA1, DMA_CHANNEL1, DMA_CCR_PL_VERY_HIGH);
+	dma_enable_circular_mode(DMA1, DMA_CHANNEL1);
+	dma_enable_half_transfer_interrupt(DMA1, DMA_CHANNEL1);
+	dma_enable_transfer_complete_interrupt(DMA1, DMA_CHANNEL1);
+	
+	stream_blocks = 0;
+	
+	nvic_enable_irq(NVIC_DMA1_CHANNEL1_IRQ);
+	dma_enable_channel(DMA1, DMA_CHANNEL1);
+	
+	// Both channels, back to back, continuously
+	adc_set_sample_time_on_all_channels(ADC1, STREAM_SAMPLE_TIME);
+	adc_set_regular_sequence(ADC1, STREAM_CHANNELS, channels);
+	adc_enable_scan_mode(ADC1);
+	adc_set_continuous_conversion_mode(ADC1);
+	adc_enable_dma(ADC1);
+	
+	adc_start_conversion_regular(ADC1);
+}
+
+static void stream_end() {
+	adc_set_single_conversion_mode(ADC1);
+	adc_disable_scan_mode(ADC1);
+	adc_disable_dma(ADC1);
+	
+	dma_disable_channel(DMA1, DMA_CHANNEL1);
+	nvic_disable_irq(NVIC_DMA1_CHANNEL1_IRQ);
+}
+
+void stream_run(bool (*stop)()) {
+	proto_stream_t record = {.header = {.type = PROTO_STREAM}};
+	uint32_t next = 0;
+	
+	// Within the VCP's bandwidth, see stream.h
+	chrono_settings_t s = settings;
+	s.adc_sample_time = STREAM_SAMPLE_TIME;
+	
+	record.period_ps = settings_conversion_ps(s) * STREAM_CHANNELS;
+	record.distance_um = settings.distance_um;
+	
+	stream_start();
+	
+	while(!stop()) {
+		uint32_t done = stream_blocks;
+		
+		if(done == next)
+			continue;
+		
+		// Only the newest complete block is still intact
+		if(done - next > 1) {
+			record.dropped += done - next - 1;
+			next = done - 1;
+		}
+		
+		size_t len = stream_encode(stream_buf[next % 2], STREAM_BLOCK_SAMPLES, record.data);
+		
+		// Overwritten while encoding
+		if(stream_blocks - next > 1) {
+			record.dropped++;
+			next++;
+			continue;
+		}
+		
+		record.block = next++;
+		proto_send(record.header, offsetof(proto_stream_t, data) + len);
+	}
+	
+	stream_end();
+}
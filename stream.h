@@ -0,0 +1,137 @@
+/**
+ * Raw ADC streaming ("oscilloscope" mode).
+ *
+ * The ADC converts both photodiode channels back to back, at its
+ * full rate, and DMA writes them into a double buffer of blocks.
+ * Each complete block is delta and varint encoded into a
+ * PROTO_STREAM record, and sent over the VCP. Blocks that are
+ * overwritten before they could be sent are dropped and counted,
+ * so the receiver can keep the samples aligned in time.
+ *
+ * Encoding: samples are interleaved, front first. Each is stored
+ * as the difference to the previous sample of its channel, in the
+ * same block (the first as is), zigzag-mapped to an unsigned value,
+ * and written 7 bits per byte, least significant first, with the
+ * top bit set on all but the last byte. Photodiode noise is small,
+ * so most samples take a single byte.
+ *
+ * Bandwidth: USB FS bulk transfers peak at 19 packets of 64 bytes
+ * per 1 ms frame (1.2 MB/s), and the VCP sustains about half of it,
+ * STREAM_BUDGET_BPS. A block of quiet signal is about 155 bytes on
+ * the wire: 128 one-byte samples, the record's 20 bytes, the CRC,
+ * COBS and the delimiters. That's 2.4 bytes per pair.
+ *
+ *   sample time   per pair   pairs/s   bytes/s
+ *   28.5 cycles   2.28 us    438 k     1.05 MB/s   (the default)
+ *   71.5 cycles   4.67 us    214 k      515 kB/s   (streams)
+ *
+ * With the ADC at 36 MHz (PCLK2 / 2). At the measurement's default
+ * sample time, most blocks would be dropped, so streams convert at
+ * STREAM_SAMPLE_TIME instead. Noisier signals take more bytes per
+ * sample, and drop blocks sooner.
+ *
+ * Started with the `stream` command, and stopped by the next
+ * command line. Host-side, see host/streamrec.cpp.
+ */
+
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "protocol.h"
+
+// -------------------------------------------------
+
+#define STREAM_CHANNELS 2
+
+// See the table above
+#define STREAM_BUDGET_BPS 600000
+#define STREAM_SAMPLE_TIME ADC_SMPR_SMP_71DOT5CYC
+
+// Sample pairs per block
+#define STREAM_BLOCK_PAIRS 64
+#define STREAM_BLOCK_SAMPLES (STREAM_BLOCK_PAIRS * STREAM_CHANNELS)
+
+// 12-bit samples take at most 2 bytes
+#define STREAM_DATA_MAX (STREAM_BLOCK_SAMPLES * 2)
+
+typedef struct __attribute__((packed)) {
+	proto_header_t header;
+	
+	// Block index since the stream started
+	uint32_t block;
+	
+	// Blocks dropped since the stream started
+	uint32_t dropped;
+	
+	// Time between samples of a channel (ps)
+	uint32_t period_ps;
+	
+	// Between the gates (um), for the trace's header
+	uint32_t distance_um;
+	
+	uint8_t data[STREAM_DATA_MAX];
+} proto_stream_t;
+
+static_assert(sizeof(proto_stream_t) <= PROTO_RECORD_MAX, "Record too large");
+
+// -------------------------------------------------
+
+/* Encode count interleaved samples, a block (STREAM_BLOCK_SAMPLES)
+ * or a trace chunk (see trace.h). Returns the data's length, at
+ * most 3 bytes per sample (2 for 12-bit samples). */
+inline size_t stream_encode(const uint16_t *samples, size_t count, uint8_t *dst) {
+	uint16_t prev[STREAM_CHANNELS] = {};
+	size_t n = 0;
+	
+	for(size_t i = 0; i < count; i++) {
+		int16_t delta = samples[i] - prev[i % STREAM_CHANNELS];
+		uint16_t v = (uint16_t) (delta << 1) ^ (uint16_t) (delta >> 15);
+		
+		prev[i % STREAM_CHANNELS] = samples[i];
+		
+		for(; v >= 0x80; v >>= 7)
+			dst[n++] = v | 0x80;
+		
+		dst[n++] = v;
+	}
+	
+	return n;
+}
+
+/* Decode data into count interleaved samples. Returns
+ * false if the data doesn't hold exactly count samples. */
+inline bool stream_decode(const uint8_t *src, size_t len, uint16_t *samples, size_t count) {
+	uint16_t prev[STREAM_CHANNELS] = {};
+	size_t n = 0;
+	
+	for(size_t i = 0; i < count; i++) {
+		uint32_t v = 0;
+		int shift = 0;
+		
+		do {
+			if(n == len || shift > 14)
+				return false;
+			
+			v |= (uint32_t) (src[n] & 0x7F) << shift;
+			shift += 7;
+		} while(src[n++] & 0x80);
+		
+		int16_t delta = (v >> 1) ^ -(int32_t) (v & 1);
+		
+		samples[i] = prev[i % STREAM_CHANNELS] + delta;
+		prev[i % STREAM_CHANNELS] = samples[i];
+	}
+	
+	return n == len;
+}
+
+// -------------------------------------------------
+
+/* Firmware only, see stream.cpp. Streams until stop() returns true,
+ * leaving the ADC in single conversion mode, to be set up again. */
+void stream_run(bool (*stop)());
+
+#endif
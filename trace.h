@@ -0,0 +1,100 @@
+/**
+ * Sample trace files, as written by host/streamrec.
+ *
+ * Layout, little-endian:
+ *
+ *   trace_header_t
+ *   chunks, back to back
+ *   index: the chunks' offsets (uint64), num_chunks + 1 of them,
+ *          the last being the end of the chunks, then num_shots
+ *          trace_shot_t
+ *
+ * A chunk is a trace_chunk_t, followed by TRACE_CHUNK_PAIRS sample
+ * pairs (the last chunk may hold fewer), encoded as one stream
+ * block (see stream.h): interleaved, front first, as delta-coded
+ * varints. Samples of blocks that were dropped are TRACE_GAP, so
+ * that a sample's index stays proportional to its time.
+ *
+ * Chunks are fixed-size in samples, so the chunk holding any time
+ * is found without reading the samples, and decoded on its own.
+ * Shots are located by the index, e.g. as found by the detector
+ * (chrono_sim -x). It's rewritten in place, at the end of the file.
+ *
+ * The header's index_offset is only set once the index is written.
+ * Until then (e.g. a capture cut short), the chunks can still be
+ * read in order, by their lengths. Host-side, see host/trace_file.h.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+#include "stream.h"
+
+// -------------------------------------------------
+
+// "CHTR"
+#define TRACE_MAGIC 0x52544843
+#define TRACE_VERSION 2
+
+// Not a 12-bit ADC value
+#define TRACE_GAP 0xFFFF
+
+// Sample pairs per chunk, a multiple of STREAM_BLOCK_PAIRS
+#define TRACE_CHUNK_PAIRS 4096
+#define TRACE_CHUNK_SAMPLES (TRACE_CHUNK_PAIRS * STREAM_CHANNELS)
+
+// Largest encoded chunk, with any 16-bit samples
+#define TRACE_CHUNK_DATA_MAX (TRACE_CHUNK_SAMPLES * 3)
+
+typedef struct __attribute__((packed)) {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t channels;
+	
+	// Time between samples of a channel (ps)
+	uint32_t period_ps;
+	
+	// Between the gates (um), 0 if unknown
+	uint32_t distance_um;
+	
+	// ADC channel of each trace channel
+	uint8_t channel_map[4];
+	
+	uint32_t chunk_pairs;
+	
+	uint64_t num_pairs;
+	uint64_t num_chunks;
+	
+	// 0 until the index is written
+	uint64_t index_offset;
+	uint32_t num_shots;
+	
+	uint32_t reserved[3];
+} trace_header_t;
+
+static_assert(sizeof(trace_header_t) == 64, "Header size changed");
+
+typedef struct __attribute__((packed)) {
+	uint32_t pairs;
+	
+	// Encoded data, following
+	uint32_t bytes;
+} trace_chunk_t;
+
+typedef struct __attribute__((packed)) {
+	// Trigger sample pairs
+	uint64_t front_pair;
+	uint64_t rear_pair;
+	
+	uint32_t ticks;
+	uint32_t timer_freq;
+	
+	// m/s
+	float speed;
+	
+	uint32_t reserved;
+} trace_shot_t;
+
+#endif
@@ -0,0 +1,35 @@
+/**
+ * Ring buffer of the most recent measurements, for the
+ * trend chart. Only the last TREND_SHOTS are kept, but
+ * the total count keeps increasing, so that readers can
+ * tell how many were added since they last looked.
+ */
+
+#ifndef TREND_H
+#define TREND_H
+
+#include <stdint.h>
+
+// The display's 128 columns, plus the shot before the
+// oldest one, which the chart's leftmost column spans from
+#define TREND_SHOTS 129
+
+typedef struct {
+	float values[TREND_SHOTS];
+	uint32_t total;
+} trend_t;
+
+inline void trend_add(trend_t &t, float value) {
+	t.values[t.total++ % TREND_SHOTS] = value;
+}
+
+inline uint32_t trend_count(const trend_t &t) {
+	return t.total < TREND_SHOTS ? t.total : TREND_SHOTS;
+}
+
+// The k-th most recent value, 0 being the newest
+inline float trend_get(const trend_t &t, uint32_t k) {
+	return t.values[(t.total - 1 - k) % TREND_SHOTS];
+}
+
+#endif